@@ -0,0 +1,256 @@
+/*
+    Bulk operations on indexed objects.
+
+    Arrays, ByteArrays and Strings used to be copied, filled, searched
+    and compared one element at a time through at: and at:put: sends.
+    Primitives 220-229 do it here on the objects' memory instead: a
+    copy is a memcpy with one pass to add the references, a comparison
+    of bytes is a memcmp, a search of bytes is a memchr.
+
+    The functions here also serve the other modules that handle byte
+    objects as a whole (see dict.c and sort.c).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "common.h"
+#include "memory.h"
+#include "names.h"
+#include "news.h"
+#include "tty.h"
+
+#include "bulk.h"
+
+boolean
+isIndexed(object obj) {
+    return !isInteger(obj) && obj != nilobj;
+}// isIndexed
+
+boolean
+isBytes(object obj) {
+    return isIndexed(obj) && sizeField(obj) < 0;
+}// isBytes
+
+int
+indexedSize(object obj) {
+    if (sizeField(obj) >= 0) {
+        return sizeField(obj);
+    }
+    return byteLength(obj);
+}// indexedSize
+
+
+// Make a new object of class cls holding size elements, pointers or
+// bytes as proto is.
+static object
+newLike(object proto, object cls, int size) {
+    object result;
+
+    if (sizeField(proto) >= 0) {
+        result = allocObject(size);
+    } else {
+        result = allocByte(size);
+    }
+    setClass(result, cls);
+    return result;
+}// newLike
+
+// Copy count elements of src, from index from (1-based), into dest at
+// index to.  Both must be the same kind of object, and the ranges must
+// be valid.  Overlapping ranges are fine.
+static void
+copyElements(object dest, int to, object src, int from, int count) {
+    object *old, *items;
+
+    if (count <= 0) { return; }
+
+    if (sizeField(dest) < 0) {
+        memmove(bytePtr(dest) + to - 1, bytePtr(src) + from - 1, count);
+        return;
+    }
+
+    // Take the new references before dropping the old ones, which may
+    // be the same objects.
+    items = sysMemPtr(src) + from - 1;
+    for (int n = 0; n < count; n++) {
+        incr(items[n]);
+    }
+    old = ck_realloc(NULL, count * sizeof(object));
+    memcpy(old, sysMemPtr(dest) + to - 1, count * sizeof(object));
+    memmove(sysMemPtr(dest) + to - 1, items, count * sizeof(object));
+    for (int n = 0; n < count; n++) {
+        decr(old[n]);
+    }
+    free(old);
+}// copyElements
+
+// Return a copy of obj's elements low to high, clamped to its size, as
+// Array>>copyFrom:to: always has.
+object
+copyRange(object obj, int low, int high) {
+    int size = indexedSize(obj);
+    object result;
+
+    if (low < 1) { low = 1; }
+    if (high > size) { high = size; }
+    if (high < low) { high = low - 1; }
+
+    result = newLike(obj, classField(obj), high - low + 1);
+    copyElements(result, 1, obj, low, high - low + 1);
+    return result;
+}// copyRange
+
+// Return a copy of obj as an instance of cls with size elements,
+// truncated or padded with nil (or 0).
+object
+copyResized(object obj, object cls, int size) {
+    int count = indexedSize(obj);
+    object result = newLike(obj, cls, size);
+
+    copyElements(result, 1, obj, 1, count < size ? count : size);
+    return result;
+}// copyResized
+
+
+// Compare the bytes of a and b as ByteArray>>< does: byte by byte,
+// with a prefix before anything longer.
+int
+bytesCompare(object a, object b) {
+    int sizeA = indexedSize(a), sizeB = indexedSize(b);
+    int cmp = memcmp(bytePtr(a), bytePtr(b), sizeA < sizeB ? sizeA : sizeB);
+
+    if (cmp) { return cmp < 0 ? -1 : 1; }
+    return sizeA < sizeB ? -1 : sizeA > sizeB;
+}// bytesCompare
+
+// Hash the bytes of obj a word at a time, into a non-negative
+// SmallInteger.  (OBJINT_MAX is one less than a power of two, so it
+// serves as the mask.)
+int
+bytesHash(object obj) {
+    const byte *p = bytePtr(obj);
+    int size = indexedSize(obj);
+    uint64_t hash = 14695981039346656037u;
+    uint64_t word;
+    int n;
+
+    for (n = 0; n + 8 <= size; n += 8) {
+        memcpy(&word, p + n, 8);
+        hash = (hash ^ word) * 1099511628211u;
+        hash ^= hash >> 29;
+    }
+    word = 0;
+    memcpy(&word, p + n, size - n);
+    hash = (hash ^ word ^ (uint64_t)size << 56) * 1099511628211u;
+    hash ^= hash >> 32;
+
+    return (int)(hash & OBJINT_MAX);
+}// bytesHash
+
+
+// Primitives 220-229.
+object
+bulkPrimitive(int number, object *arguments) {
+    object returnedObject = nilobj;
+    object obj = arguments[0];
+    int size, start, stop, from;
+
+    if (!isIndexed(obj)) {
+        return nilobj;
+    }
+    size = indexedSize(obj);
+
+    switch (number) {
+    case 0:         /* replaceFrom:to:with:startingAt: */
+        if (!isInteger(arguments[1]) || !isInteger(arguments[2]) ||
+            !isIndexed(arguments[3]) || !isInteger(arguments[4]) ||
+            isBytes(obj) != isBytes(arguments[3])) {
+            break;
+        }
+        start = intValue(arguments[1]);
+        stop = intValue(arguments[2]);
+        from = intValue(arguments[4]);
+        if (start < 1 || stop > size || stop < start - 1 || from < 1 ||
+            from + (stop - start) > indexedSize(arguments[3])) {
+            break;
+        }
+        copyElements(obj, start, arguments[3], from, stop - start + 1);
+        returnedObject = obj;
+        break;
+
+    case 1:         /* copyFrom:to: */
+        if (isInteger(arguments[1]) && isInteger(arguments[2])) {
+            returnedObject = copyRange(obj, intValue(arguments[1]),
+                                       intValue(arguments[2]));
+        }
+        break;
+
+    case 2:         /* copy as class with size */
+        if (isInteger(arguments[1]) && intValue(arguments[1]) >= 0 &&
+            isIndexed(arguments[2])) {
+            returnedObject = copyResized(obj, arguments[2],
+                                         intValue(arguments[1]));
+        }
+        break;
+
+    case 3:         /* atAllPut: */
+        if (!isBytes(obj)) {
+            object *items = sysMemPtr(obj);
+
+            for (int n = 0; n < size; n++) {
+                incr(arguments[1]);
+                decr(items[n]);
+                items[n] = arguments[1];
+            }
+            returnedObject = obj;
+        } else if (isInteger(arguments[1]) && intValue(arguments[1]) >= 0 &&
+                   intValue(arguments[1]) <= 255) {
+            memset(bytePtr(obj), intValue(arguments[1]), size);
+            returnedObject = obj;
+        }
+        break;
+
+    case 4:         /* identityIndexOf:, 0 if absent */
+        returnedObject = newInteger(0);
+        if (!isBytes(obj)) {
+            object *items = sysMemPtr(obj);
+
+            for (int n = 0; n < size; n++) {
+                if (items[n] == arguments[1]) {
+                    returnedObject = newInteger(n + 1);
+                    break;
+                }
+            }
+        } else if (isInteger(arguments[1]) && intValue(arguments[1]) >= 0 &&
+                   intValue(arguments[1]) <= 255) {
+            byte *p = bytePtr(obj);
+            byte *found = memchr(p, intValue(arguments[1]), size);
+
+            if (found) {
+                returnedObject = newInteger(found - p + 1);
+            }
+        }
+        break;
+
+    case 5:         /* compare bytes: -1, 0 or 1 */
+        if (isBytes(obj) && isBytes(arguments[1])) {
+            returnedObject = newInteger(bytesCompare(obj, arguments[1]));
+        }
+        break;
+
+    case 6:         /* hash of bytes */
+        if (isBytes(obj)) {
+            returnedObject = newInteger(bytesHash(obj));
+        }
+        break;
+
+    default:
+        sysError("unknown primitive", "bulkPrimitive");
+        break;
+    }
+
+    return returnedObject;
+}// bulkPrimitive
@@ -0,0 +1,17 @@
+/*
+    Bulk operations on Arrays, ByteArrays and Strings.
+*/
+
+#ifndef __BULK_H
+#define __BULK_H
+
+extern boolean isIndexed(object obj);
+extern boolean isBytes(object obj);
+extern int indexedSize(object obj);
+extern object copyRange(object obj, int low, int high);
+extern object copyResized(object obj, object cls, int size);
+extern int bytesCompare(object a, object b);
+extern int bytesHash(object obj);
+extern object bulkPrimitive(int number, object *arguments);
+
+#endif
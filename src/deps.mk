@@ -0,0 +1,46 @@
+st.o: st.c common.h env.h types.h util.h tty.h memory.h names.h unixio.h \
+ interp.h jit.h sched.h
+memory.o: memory.c common.h env.h types.h util.h tty.h memory.h unixio.h \
+ names.h
+names.o: names.c common.h env.h types.h util.h tty.h memory.h news.h \
+ dict.h names.h
+news.o: news.c common.h env.h types.h util.h tty.h memory.h names.h \
+ news.h dict.h
+interp.o: interp.c common.h env.h types.h util.h tty.h memory.h names.h \
+ interp.h primitive.h news.h jit.h feedback.h sched.h interp_loop.h
+primitive.o: primitive.c common.h env.h types.h util.h tty.h memory.h \
+ names.h parser.h interp.h sched.h worker.h dict.h deque.h sort.h bulk.h \
+ stream.h longint.h vector.h news.h unixio.h
+filein.o: filein.c common.h env.h types.h util.h tty.h memory.h names.h \
+ lex.h news.h parser.h interp.h
+lex.o: lex.c common.h env.h types.h util.h tty.h memory.h lex.h
+parser.o: parser.c common.h env.h types.h util.h tty.h memory.h names.h \
+ interp.h lex.h news.h parser.h
+unixio.o: unixio.c common.h env.h types.h util.h tty.h memory.h names.h \
+ news.h filein.h sched.h
+tty.o: tty.c common.h env.h types.h util.h tty.h memory.h names.h \
+ feedback.h
+jit.o: jit.c common.h env.h types.h util.h tty.h memory.h names.h \
+ interp.h jit.h
+feedback.o: feedback.c common.h env.h types.h util.h tty.h memory.h \
+ names.h news.h feedback.h
+sched.o: sched.c common.h env.h types.h util.h tty.h memory.h names.h \
+ interp.h news.h sched.h
+worker.o: worker.c common.h env.h types.h util.h tty.h memory.h names.h \
+ news.h sched.h worker.h
+dict.o: dict.c common.h env.h types.h util.h tty.h memory.h names.h \
+ news.h bulk.h dict.h
+deque.o: deque.c common.h env.h types.h util.h tty.h memory.h names.h \
+ news.h deque.h
+sort.o: sort.c common.h env.h types.h util.h tty.h memory.h names.h \
+ news.h interp.h bulk.h sort.h
+bulk.o: bulk.c common.h env.h types.h util.h tty.h memory.h names.h \
+ news.h bulk.h
+stream.o: stream.c common.h env.h types.h util.h tty.h memory.h names.h \
+ news.h bulk.h stream.h
+longint.o: longint.c common.h env.h types.h util.h tty.h memory.h names.h \
+ news.h bulk.h longint.h
+vector.o: vector.c common.h env.h types.h util.h tty.h memory.h names.h \
+ news.h bulk.h longint.h vector.h
+initial.o: initial.c common.h env.h types.h util.h tty.h memory.h names.h \
+ news.h dict.h parser.h interp.h
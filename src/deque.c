@@ -0,0 +1,284 @@
+/*
+    Deques, for OrderedCollection.
+
+    An OrderedCollection keeps its items in an Array laid out like the
+    scheduler's rings (see sched.c): the index of the first item, the
+    number of items and then the item slots, used circularly so that
+    items can be added and removed at either end without moving the
+    rest.  When the slots run out the Array is doubled in place, so the
+    OrderedCollection never has to replace it.
+
+    All the work is done here by primitives 200-209; moving items
+    around inside the Array never touches their reference counts.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "memory.h"
+#include "names.h"
+#include "news.h"
+#include "tty.h"
+
+#include "deque.h"
+
+enum {
+    DEQUE_HEAD = 1,             // field: item slot (from 0) of the first item
+    DEQUE_COUNT = 2,            // field: the number of items
+    DEQUE_ITEMS = 2,            // memory offset of the first item slot
+
+    MIN_CAPACITY = 8,
+};
+
+static inline int
+headOf(object deque) {
+    return intValue(basicAt(deque, DEQUE_HEAD));
+}// headOf
+
+static inline int
+countOf(object deque) {
+    return intValue(basicAt(deque, DEQUE_COUNT));
+}// countOf
+
+static inline int
+capacityOf(object deque) {
+    return sizeField(deque) - DEQUE_ITEMS;
+}// capacityOf
+
+static inline void
+setHeadAndCount(object deque, int head, int count) {
+    simpleAtPut(deque, DEQUE_HEAD, newInteger(head));
+    simpleAtPut(deque, DEQUE_COUNT, newInteger(count));
+}// setHeadAndCount
+
+// The memory slot of item n (from 0).
+static inline object *
+slotOf(object deque, int n) {
+    return sysMemPtr(deque) + DEQUE_ITEMS +
+        (headOf(deque) + n) % capacityOf(deque);
+}// slotOf
+
+
+object
+newDeque(int capacity) {
+    object deque;
+
+    if (capacity < MIN_CAPACITY) {
+        capacity = MIN_CAPACITY;
+    }
+
+    deque = newArray(DEQUE_ITEMS + capacity);
+    setHeadAndCount(deque, 0, 0);
+    return deque;
+}// newDeque
+
+// Make room for at least one more item.  Returns FALSE if the deque
+// is as big as it can get.
+static boolean
+makeRoom(object deque) {
+    int capacity = capacityOf(deque);
+    int head = headOf(deque);
+    int wrapped;
+    object *mem;
+
+    if (countOf(deque) < capacity) { return TRUE; }
+    if (DEQUE_ITEMS + capacity >= OBJSIZE_MAX) {
+        sysWarn("OrderedCollection too big", "");
+        return FALSE;
+    }
+
+    growObject(deque, DEQUE_ITEMS + (capacity * 2 < OBJSIZE_MAX - DEQUE_ITEMS
+                                     ? capacity * 2
+                                     : OBJSIZE_MAX - DEQUE_ITEMS));
+
+    // Move the items that had wrapped around to the start after the
+    // others, into the new slots.
+    mem = sysMemPtr(deque) + DEQUE_ITEMS;
+    wrapped = head;     // the full deque wraps at slot 'capacity'
+    if (wrapped > capacityOf(deque) - capacity) {
+        // Not enough new slots for them all; move the head part to the
+        // end instead.
+        int tail = capacity - head;
+        int newHead = capacityOf(deque) - tail;
+
+        memmove(mem + newHead, mem + head, tail * sizeof(object));
+        memset(mem + head, 0, (newHead - head) * sizeof(object));
+        simpleAtPut(deque, DEQUE_HEAD, newInteger(newHead));
+    } else {
+        memcpy(mem + capacity, mem, wrapped * sizeof(object));
+        memset(mem, 0, wrapped * sizeof(object));
+    }
+
+    return TRUE;
+}// makeRoom
+
+boolean
+dequeAddLast(object deque, object item) {
+    if (!makeRoom(deque)) { return FALSE; }
+
+    incr(item);
+    *slotOf(deque, countOf(deque)) = item;
+    simpleAtPut(deque, DEQUE_COUNT, newInteger(countOf(deque) + 1));
+    return TRUE;
+}// dequeAddLast
+
+boolean
+dequeAddFirst(object deque, object item) {
+    int head;
+
+    if (!makeRoom(deque)) { return FALSE; }
+
+    head = (headOf(deque) + capacityOf(deque) - 1) % capacityOf(deque);
+    setHeadAndCount(deque, head, countOf(deque) + 1);
+    incr(item);
+    *slotOf(deque, 0) = item;
+    return TRUE;
+}// dequeAddFirst
+
+// Remove the first (or last) item and return it along with the
+// deque's reference to it, which the caller must drop.
+object
+dequeRemove(object deque, boolean last) {
+    int count = countOf(deque);
+    object *slot, item;
+
+    if (count == 0) { return nilobj; }
+
+    slot = slotOf(deque, last ? count - 1 : 0);
+    item = *slot;
+    *slot = nilobj;
+    setHeadAndCount(deque,
+                    last ? headOf(deque)
+                         : (headOf(deque) + 1) % capacityOf(deque),
+                    count - 1);
+    return item;
+}// dequeRemove
+
+// Return the items as an Array.
+object
+dequeAsArray(object deque) {
+    int count = countOf(deque);
+    int capacity = capacityOf(deque);
+    int head = headOf(deque);
+    int first = head + count <= capacity ? count : capacity - head;
+    object result = newArray(count);
+    object *mem = sysMemPtr(result);
+
+    memcpy(mem, sysMemPtr(deque) + DEQUE_ITEMS + head,
+           first * sizeof(object));
+    memcpy(mem + first, sysMemPtr(deque) + DEQUE_ITEMS,
+           (count - first) * sizeof(object));
+    for (int n = 0; n < count; n++) {
+        incr(mem[n]);
+    }
+
+    return result;
+}// dequeAsArray
+
+
+// Check that obj looks like a deque, so that a stray Array can't send
+// the primitives outside its memory.
+static boolean
+isDeque(object obj) {
+    return !isInteger(obj) && obj != nilobj &&
+        sizeField(obj) > DEQUE_ITEMS &&
+        isInteger(basicAt(obj, DEQUE_HEAD)) &&
+        isInteger(basicAt(obj, DEQUE_COUNT)) &&
+        headOf(obj) >= 0 && headOf(obj) < capacityOf(obj) &&
+        countOf(obj) >= 0 && countOf(obj) <= capacityOf(obj);
+}// isDeque
+
+// Return the slot of item 'index' (from 1), or NULL if it is out of
+// range.
+static object *
+itemSlot(object deque, object index) {
+    int n = isInteger(index) ? intValue(index) : 0;
+
+    if (n < 1 || n > countOf(deque)) { return NULL; }
+    return slotOf(deque, n - 1);
+}// itemSlot
+
+
+// Primitives 200-209.
+object
+dequePrimitive(int number, object *arguments) {
+    object returnedObject = nilobj;
+    object deque = arguments[0];
+    object *slot;
+
+    if (number != 0 && !isDeque(deque)) {
+        return nilobj;
+    }
+
+    switch (number) {
+    case 0:         /* new deque */
+        if (isInteger(arguments[0])) {
+            returnedObject = newDeque(intValue(arguments[0]));
+        }
+        break;
+
+    case 1:         /* addLast: */
+        if (dequeAddLast(deque, arguments[1])) {
+            returnedObject = arguments[1];
+        }
+        break;
+
+    case 2:         /* addFirst: */
+        if (dequeAddFirst(deque, arguments[1])) {
+            returnedObject = arguments[1];
+        }
+        break;
+
+    case 3:         /* removeFirst */
+    case 4:         /* removeLast */
+        returnedObject = dequeRemove(deque, number == 4);
+        disown(returnedObject);
+        break;
+
+    case 5:         /* at: */
+        slot = itemSlot(deque, arguments[1]);
+        if (slot) {
+            returnedObject = *slot;
+        }
+        break;
+
+    case 6:         /* at:put: */
+        slot = itemSlot(deque, arguments[1]);
+        if (slot) {
+            object old = *slot;
+
+            incr(arguments[2]);
+            *slot = arguments[2];
+            decr(old);
+            returnedObject = arguments[2];
+        }
+        break;
+
+    case 7:         /* asArray */
+        returnedObject = dequeAsArray(deque);
+        break;
+
+    case 8:         /* add all the items of an Array at the end */
+        if (!isInteger(arguments[1]) && arguments[1] != nilobj &&
+            sizeField(arguments[1]) >= 0 && arguments[1] != deque) {
+            object items = arguments[1];
+
+            returnedObject = trueobj;
+            for (int n = 1; n <= sizeField(items); n++) {
+                if (!dequeAddLast(deque, basicAt(items, n))) {
+                    returnedObject = nilobj;
+                    break;
+                }
+            }
+        }
+        break;
+
+    default:
+        sysError("unknown primitive", "dequePrimitive");
+        break;
+    }
+
+    return returnedObject;
+}// dequePrimitive
@@ -0,0 +1,15 @@
+/*
+    Native deques, for OrderedCollection.
+*/
+
+#ifndef __DEQUE_H
+#define __DEQUE_H
+
+extern object newDeque(int capacity);
+extern boolean dequeAddLast(object deque, object item);
+extern boolean dequeAddFirst(object deque, object item);
+extern object dequeRemove(object deque, boolean last);
+extern object dequeAsArray(object deque);
+extern object dequePrimitive(int number, object *arguments);
+
+#endif
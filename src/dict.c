@@ -0,0 +1,531 @@
+/*
+    Native hash tables.
+
+    Dictionary (and the name tables the interpreter uses, which are
+    Dictionaries too) and Set keep their contents in a single Array
+    laid out as
+
+        [tally, identity, hash1, key1, value1, hash2, key2, value2, ...]
+
+    (a Set's values are all nil) where the entries form an open-
+    addressing table whose capacity is a power of two.  Collisions are
+    resolved by linear probing with Robin Hood insertion (an entry
+    never sits further from its home slot than the one it would
+    displace) and removal by shifting the following entries back, so
+    there are no tombstones and a lookup can stop as soon as it passes
+    the point where its key would be.
+    The table grows in place once it is three quarters full.
+
+    Each entry keeps its key's hash, so the table can be probed and
+    rehashed without asking the keys.  For the keys C can compare by
+    itself (SmallIntegers, Symbols, Strings, classes and the
+    constants, or anything at all in an identity table) the whole
+    operation is a primitive; for other keys the Smalltalk code
+    computes the hash and does the comparisons with '=', using
+    primitive 192 to walk the candidates.
+
+    The hash of a key is what its 'hash' method answers: the object
+    itself for most objects (see primitive 13) and bytesHash() of the
+    text for Strings.  The exception is the global symbol table,
+    which is hashed by name (see names.c) so that a Symbol can be
+    found from its text.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "memory.h"
+#include "names.h"
+#include "news.h"
+#include "tty.h"
+
+#include "bulk.h"
+#include "dict.h"
+
+enum {
+    TABLE_TALLY = 1,            // the number of entries
+    TABLE_IDENTITY = 2,         // 1 if keys are compared with ==
+    TABLE_HEADER = 2,           // slots before the first entry
+    ENTRY_SIZE = 3,             // slots per entry: hash, key, value
+
+    MIN_CAPACITY = 8,
+};
+
+// The largest capacity that fits in an object.
+static int
+maxCapacity(void) {
+    static int capacity = 0;
+
+    if (!capacity) {
+        for (capacity = MIN_CAPACITY;
+             TABLE_HEADER + 2 * capacity * ENTRY_SIZE <= OBJSIZE_MAX;
+             capacity *= 2) {}
+    }
+    return capacity;
+}// maxCapacity
+
+
+static object symbolClass = 0, stringClass = 0, classClass = 0;
+
+static void
+findClasses(void) {
+    if (stringClass == nilobj) {
+        symbolClass = globalSymbol("Symbol");
+        stringClass = globalSymbol("String");
+        classClass = globalSymbol("Class");
+    }
+}// findClasses
+
+
+/*
+    Table layout.
+*/
+
+static inline int
+capacityOf(object table) {
+    return (sizeField(table) - TABLE_HEADER) / ENTRY_SIZE;
+}// capacityOf
+
+// Index (from 1) of entry n's hash (from 0); the key and value follow.
+static inline int
+entryAt(int n) {
+    return TABLE_HEADER + n * ENTRY_SIZE + 1;
+}// entryAt
+
+static inline int
+tallyOf(object table) {
+    return intValue(basicAt(table, TABLE_TALLY));
+}// tallyOf
+
+static inline void
+setTally(object table, int tally) {
+    simpleAtPut(table, TABLE_TALLY, newInteger(tally));
+}// setTally
+
+static inline boolean
+isIdentityTable(object table) {
+    return basicAt(table, TABLE_IDENTITY) == newInteger(1);
+}// isIdentityTable
+
+// The slot an entry with this hash would ideally occupy.  The hash is
+// scrambled first since object references are all even.
+static inline int
+homeOf(int hash, int capacity) {
+    return (int) (((unsigned) hash * 2654435761u) >> 7) & (capacity - 1);
+}// homeOf
+
+// How far the entry in slot n is from its home slot.
+static inline int
+distanceOf(object *mem, int n, int capacity) {
+    int hash = intValue(mem[entryAt(n) - 1]);
+    return (n - homeOf(hash, capacity)) & (capacity - 1);
+}// distanceOf
+
+static inline boolean
+isEmpty(object *mem, int n) {
+    return mem[entryAt(n) - 1] == nilobj;
+}// isEmpty
+
+
+
+/*
+    Keys.
+*/
+
+// Store key's hash in *hash and return TRUE if C can compare it with
+// other keys by itself.
+static boolean
+keyHash(object table, object key, int *hash) {
+    object cls;
+
+    if (isInteger(key)) {
+        *hash = intValue(key);
+        return TRUE;
+    }
+
+    *hash = key;
+    if (isIdentityTable(table) ||
+        key == nilobj || key == trueobj || key == falseobj) {
+        return TRUE;
+    }
+
+    findClasses();
+    cls = getClass(key);
+    if (cls == symbolClass || cls == classClass) {
+        return TRUE;
+    }
+    if (cls == stringClass) {
+        *hash = bytesHash(key);
+        return TRUE;
+    }
+
+    return FALSE;
+}// keyHash
+
+// Test if entry is equal to key, which keyHash() accepted.  A
+// SmallInteger is equal to an integral Float (which hashes the same,
+// see Float>>hash) except in an identity table.
+static boolean
+keyEquals(object table, object entry, object key) {
+    if (entry == key) { return TRUE; }
+    if (isInteger(entry) || entry == nilobj) { return FALSE; }
+    if (isInteger(key)) {
+        return !isIdentityTable(table) && getClass(entry) == floatClass &&
+            floatValue(entry) == intValue(key);
+    }
+    if (getClass(key) != stringClass || getClass(entry) != stringClass) {
+        return FALSE;
+    }
+
+    return bytesCompare(key, entry) == 0;
+}// keyEquals
+
+
+
+/*
+    Table operations.
+*/
+
+static int
+tableSize(int capacity) {
+    int size = MIN_CAPACITY;
+
+    while (size < capacity && size < maxCapacity()) {
+        size *= 2;
+    }
+    return TABLE_HEADER + size * ENTRY_SIZE;
+}// tableSize
+
+static object
+initTable(object table, boolean identity) {
+    simpleAtPut(table, TABLE_TALLY, newInteger(0));
+    simpleAtPut(table, TABLE_IDENTITY, newInteger(identity ? 1 : 0));
+    return table;
+}// initTable
+
+// Make a table with room for at least capacity entries.  This one has
+// no class yet, for use before Array exists.
+object
+allocHashTable(int capacity, boolean identity) {
+    return initTable(allocObject(tableSize(capacity)), identity);
+}// allocHashTable
+
+object
+newHashTable(int capacity, boolean identity) {
+    return initTable(newArray(tableSize(capacity)), identity);
+}// newHashTable
+
+
+// Return the index of the value of the first entry for hash after the
+// value at index 'after' (or the first one if after is 0), or 0 if
+// there isn't one.
+int
+hashTableNext(object table, int hash, int after) {
+    int capacity = capacityOf(table);
+    object *mem = sysMemPtr(table);
+    object hashObj = newInteger(hash);
+    int n = homeOf(hash, capacity);
+
+    for (int dist = 0; dist < capacity; dist++, n = (n + 1) & (capacity-1)) {
+        int valueIndex = entryAt(n) + 2;
+
+        if (isEmpty(mem, n) || distanceOf(mem, n, capacity) < dist) {
+            break;
+        }
+        if (mem[entryAt(n) - 1] != hashObj) { continue; }
+
+        if (after == 0) { return valueIndex; }
+        if (after == valueIndex) { after = 0; }
+    }
+
+    return 0;
+}// hashTableNext
+
+// Return the index of key's value, 0 if it is absent or -1 if C
+// can't compare it.
+int
+hashTableFind(object table, object key) {
+    int hash, index = 0;
+
+    if (!keyHash(table, key, &hash)) { return -1; }
+
+    while ((index = hashTableNext(table, hash, index)) != 0) {
+        if (keyEquals(table, basicAt(table, index - 1), key)) {
+            return index;
+        }
+    }
+    return 0;
+}// hashTableFind
+
+
+// Put an entry into slot n or displace a closer one, which is then
+// put somewhere further on in turn.  The references are taken over
+// from the caller.
+static void
+place(object table, object hashObj, object key, object value) {
+    int capacity = capacityOf(table);
+    object *mem = sysMemPtr(table);
+    int hash = intValue(hashObj);
+    int n = homeOf(hash, capacity);
+
+    for (int dist = 0; ; dist++, n = (n + 1) & (capacity - 1)) {
+        object *entry = &mem[entryAt(n) - 1];
+        int theirs;
+
+        if (isEmpty(mem, n)) {
+            entry[0] = hashObj;
+            entry[1] = key;
+            entry[2] = value;
+            return;
+        }
+
+        theirs = distanceOf(mem, n, capacity);
+        if (theirs < dist) {
+            object h = entry[0], k = entry[1], v = entry[2];
+            entry[0] = hashObj;
+            entry[1] = key;
+            entry[2] = value;
+            hashObj = h;
+            key = k;
+            value = v;
+            dist = theirs;
+        }
+    }
+}// place
+
+// Double the capacity of table (in place).
+static void
+grow(object table) {
+    int capacity = capacityOf(table);
+    int size = capacity * ENTRY_SIZE;
+    object *old = ck_calloc(size, sizeof(object));
+
+    // The entries move without their reference counts changing.
+    memcpy(old, sysMemPtr(table) + TABLE_HEADER, size * sizeof(object));
+    growObject(table, TABLE_HEADER + 2 * size);
+    memset(sysMemPtr(table) + TABLE_HEADER, 0, size * sizeof(object));
+
+    for (int n = 0; n < capacity; n++) {
+        object *entry = &old[n * ENTRY_SIZE];
+        if (entry[0] != nilobj) {
+            place(table, entry[0], entry[1], entry[2]);
+        }
+    }
+
+    free(old);
+}// grow
+
+// Add an entry for a key that isn't in the table yet.  Returns FALSE
+// if the table is full.
+boolean
+hashTableAdd(object table, int hash, object key, object value) {
+    int capacity = capacityOf(table);
+    int tally = tallyOf(table);
+
+    if ((tally + 1) * 4 > capacity * 3 && capacity < maxCapacity()) {
+        grow(table);
+    } else if (tally == capacity) {
+        sysWarn("hash table full", "");
+        return FALSE;
+    }
+
+    incr(key);
+    incr(value);
+    place(table, newInteger(hash), key, value);
+    setTally(table, tally + 1);
+    return TRUE;
+}// hashTableAdd
+
+// Replace the value at index.
+void
+hashTableSetValue(object table, int index, object value) {
+    object old = basicAt(table, index);
+
+    incr(value);
+    simpleAtPut(table, index, value);
+    decr(old);
+}// hashTableSetValue
+
+// Add or replace key's entry.  Returns 1 if that worked, 0 if the
+// table is full or -1 if C can't compare key.
+int
+hashTablePut(object table, object key, object value) {
+    int hash, index;
+
+    index = hashTableFind(table, key);
+    if (index < 0) { return -1; }
+
+    if (index > 0) {
+        hashTableSetValue(table, index, value);
+        return 1;
+    }
+
+    keyHash(table, key, &hash);
+    return hashTableAdd(table, hash, key, value) ? 1 : 0;
+}// hashTablePut
+
+// Remove the entry whose value is at index.  The value is returned
+// with the table's reference to it, which the caller must drop.
+object
+hashTableRemove(object table, int index) {
+    int capacity = capacityOf(table);
+    object *mem = sysMemPtr(table);
+    int n = (index - 3 - TABLE_HEADER) / ENTRY_SIZE;
+    object key = mem[entryAt(n)], value = mem[entryAt(n) + 1];
+
+    // Shift the following entries back until one is home (or there
+    // are no more).
+    for (;;) {
+        int next = (n + 1) & (capacity - 1);
+        object *entry = &mem[entryAt(n) - 1];
+
+        if (isEmpty(mem, next) || distanceOf(mem, next, capacity) == 0) {
+            entry[0] = entry[1] = entry[2] = nilobj;
+            break;
+        }
+        memcpy(entry, &mem[entryAt(next) - 1], ENTRY_SIZE * sizeof(object));
+        n = next;
+    }
+
+    setTally(table, tallyOf(table) - 1);
+    decr(key);
+    return value;
+}// hashTableRemove
+
+// Return an Array of the keys and values, alternating, or just the
+// keys.
+object
+hashTableContents(object table, boolean withValues) {
+    int capacity = capacityOf(table);
+    object result = newArray((withValues ? 2 : 1) * tallyOf(table));
+    int at = 1;
+
+    for (int n = 0; n < capacity; n++) {
+        if (!isEmpty(sysMemPtr(table), n)) {
+            basicAtPut(result, at++, basicAt(table, entryAt(n) + 1));
+            if (withValues) {
+                basicAtPut(result, at++, basicAt(table, entryAt(n) + 2));
+            }
+        }
+    }
+
+    return result;
+}// hashTableContents
+
+// Add the items of Array 'items' from index 'start' on as keys (with
+// nil values) until one turns up that C can't compare.  Return its
+// index, 0 if all were added or -1 if the table is full.
+static int
+addAll(object table, object items, int start) {
+    for (int n = start; n <= sizeField(items); n++) {
+        int done = hashTablePut(table, basicAt(items, n), nilobj);
+        if (done <= 0) {
+            return done < 0 ? n : -1;
+        }
+    }
+    return 0;
+}// addAll
+
+
+
+// Test if obj is a table this module can work on.
+static boolean
+isTable(object obj) {
+    return !isInteger(obj) && obj != nilobj &&
+        sizeField(obj) >= TABLE_HEADER + MIN_CAPACITY * ENTRY_SIZE &&
+        isInteger(basicAt(obj, TABLE_TALLY));
+}// isTable
+
+static boolean
+isValueIndex(object table, object index) {
+    int n;
+
+    if (!isInteger(index)) { return FALSE; }
+    n = intValue(index) - TABLE_HEADER - 3;
+    return n >= 0 && n % ENTRY_SIZE == 0 &&
+        n / ENTRY_SIZE < capacityOf(table) &&
+        !isEmpty(sysMemPtr(table), n / ENTRY_SIZE);
+}// isValueIndex
+
+
+// Primitives 190-199.
+object
+dictPrimitive(int number, object *arguments) {
+    object returnedObject = nilobj;
+    object table = arguments[0];
+    int index;
+
+    if (number != 0 && !isTable(table)) {
+        return nilobj;
+    }
+
+    switch (number) {
+    case 0:         /* new table */
+        if (isInteger(arguments[0])) {
+            returnedObject = newHashTable(intValue(arguments[0]),
+                                          arguments[1] == trueobj);
+        }
+        break;
+
+    case 1:         /* index of key's value, 0 or nil */
+        index = hashTableFind(table, arguments[1]);
+        if (index >= 0) {
+            returnedObject = newInteger(index);
+        }
+        break;
+
+    case 2:         /* next candidate for a hash */
+        if (isInteger(arguments[1]) && isInteger(arguments[2])) {
+            returnedObject = newInteger(
+                hashTableNext(table, intValue(arguments[1]),
+                              intValue(arguments[2])));
+        }
+        break;
+
+    case 3:         /* at: key put: value */
+        index = hashTablePut(table, arguments[1], arguments[2]);
+        if (index >= 0) {
+            returnedObject = index ? trueobj : falseobj;
+        }
+        break;
+
+    case 4:         /* add a new key with a given hash */
+        if (isInteger(arguments[2]) &&
+            hashTableAdd(table, intValue(arguments[2]), arguments[1],
+                         arguments[3])) {
+            returnedObject = trueobj;
+        }
+        break;
+
+    case 5:         /* remove an entry, returning its value */
+        if (isValueIndex(table, arguments[1])) {
+            returnedObject = hashTableRemove(table, intValue(arguments[1]));
+            disown(returnedObject);
+        }
+        break;
+
+    case 6:         /* the keys and values */
+        returnedObject = hashTableContents(table, TRUE);
+        break;
+
+    case 7:         /* the keys */
+        returnedObject = hashTableContents(table, FALSE);
+        break;
+
+    case 8:         /* add the items of an Array */
+        if (isInteger(arguments[2]) && !isInteger(arguments[1]) &&
+            arguments[1] != nilobj && sizeField(arguments[1]) >= 0) {
+            returnedObject = newInteger(
+                addAll(table, arguments[1], intValue(arguments[2])));
+        }
+        break;
+
+    default:
+        sysError("unknown primitive", "dictPrimitive");
+        break;
+    }
+
+    return returnedObject;
+}// dictPrimitive
@@ -0,0 +1,19 @@
+/*
+    Native hash tables, for Dictionary and Set.
+*/
+
+#ifndef __DICT_H
+#define __DICT_H
+
+extern object allocHashTable(int capacity, boolean identity);
+extern object newHashTable(int capacity, boolean identity);
+extern int hashTableFind(object table, object key);
+extern int hashTableNext(object table, int hash, int after);
+extern boolean hashTableAdd(object table, int hash, object key, object value);
+extern int hashTablePut(object table, object key, object value);
+extern void hashTableSetValue(object table, int index, object value);
+extern object hashTableRemove(object table, int index);
+extern object hashTableContents(object table, boolean withValues);
+extern object dictPrimitive(int number, object *arguments);
+
+#endif
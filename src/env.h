@@ -42,6 +42,50 @@
 // those slower.)
 #define OBJECT_TABLE_MAX 6500
 
+// Number of times a method must be invoked before it is translated
+// for the fast interpreter path (see jit.c), the number of methods
+// that can be tracked at once and how many of those share a set.
+#define JIT_THRESHOLD 20
+#define JIT_TABLE_SIZE 128
+#define JIT_WAYS 4
+
+// Maximum number of methods that can have send-site feedback (see
+// feedback.c) and the number of receiver classes recorded per site.
+#define FEEDBACK_TABLE_SIZE 512
+#define FEEDBACK_CLASSES 4
+
+// Process scheduling (see sched.c): the number of bytecodes in a time
+// slice and the range of process priorities (1 is lowest).
+#define SCHED_TIME_SLICE 5000
+#define SCHED_PRIORITIES 8
+#define SCHED_DEFAULT_PRIORITY 4
+
+// How deeply primitives may nest calls back into Smalltalk (see
+// blockCallStart() in interp.c); deeper ones are left to Smalltalk.
+#define BLOCK_CALL_DEPTH 16
+
+// Worker VMs (see worker.c): the number of workers a VM can start and
+// how deeply nested an object sent to one can be.
+#define WORKER_MAX 16
+#define WORKER_MAX_DEPTH 64
+
+// Freed memory of pointer objects up to MEMORY_POOL_SLOTS in size is
+// kept for reuse (see memory.c), up to MEMORY_POOL_DEPTH blocks per
+// size.
+#define MEMORY_POOL_SLOTS 64
+#define MEMORY_POOL_DEPTH 32
+
+// Up to FLOAT_POOL_DEPTH freed Floats are kept whole for reuse (see
+// recycledFloat() in memory.c).
+#define FLOAT_POOL_DEPTH 256
+
+// The first word of an image file (see imageWrite() in memory.c).  It
+// changes whenever the image format does--as when byte objects began
+// keeping their length in the size field, or Processes grew priority,
+// state and ticket fields--so that an old image is rejected rather
+// than misread.
+#define IMAGE_VERSION 0x4C530003
+
 
 #if defined(LARGE_MEM)
 
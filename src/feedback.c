@@ -0,0 +1,211 @@
+/*
+    Type feedback collected at send sites.
+
+    While feedbackEnabled is set, the interpreter reports each send
+    that reaches method lookup and each primitive that fails (i.e.
+    answers nil).  These are tallied per site: the number of times it
+    was executed, the number of primitive failures and the first few
+    receiver classes seen there.  Sites are identified by the byte
+    offset just past the send or primitive bytecode.
+
+    Each method's sites live in a vector that is allocated the first
+    time something is recorded for it.  The vectors are found through
+    a small open-addressed table keyed on the method, which holds a
+    reference to the method (and to each recorded class) so that they
+    can't be freed and their slots reused while the data refers to
+    them.  Once the table is full, new methods are simply not tracked,
+    so the table is emptied (see feedbackReset()) each time collection
+    is turned on.
+*/
+
+#include <stdio.h>
+
+#include "common.h"
+#include "memory.h"
+#include "names.h"
+#include "news.h"
+
+#include "feedback.h"
+
+struct SiteFeedback {
+    int offset;             // byte offset just past the send
+    long count;             // times executed
+    long failures;          // primitive failures
+    int nclasses;           // distinct receiver classes seen; may be
+                            // more than FEEDBACK_CLASSES
+    object classes[FEEDBACK_CLASSES];
+};
+
+struct MethodFeedback {
+    object method;              // nilobj if the slot is free
+    int nsites, capacity;
+    struct SiteFeedback *sites; // sorted by offset
+};
+
+static struct MethodFeedback feedbackTable[FEEDBACK_TABLE_SIZE];
+static int feedbackCount = 0;
+
+boolean feedbackEnabled = FALSE;
+
+
+// Find the feedback for method, allocating it if create is TRUE.
+// Returns NULL if there is none or the table is full.
+static struct MethodFeedback *
+lookup(object method, boolean create) {
+    int slot = oNdx(method) % FEEDBACK_TABLE_SIZE;
+
+    for (int n = 0; n < FEEDBACK_TABLE_SIZE; n++) {
+        struct MethodFeedback *fb = &feedbackTable[slot];
+
+        if (fb->method == method) { return fb; }
+
+        if (fb->method == nilobj) {
+            // Leave one slot free so that lookups always terminate.
+            if (!create || feedbackCount >= FEEDBACK_TABLE_SIZE - 1) {
+                return NULL;
+            }
+
+            feedbackCount++;
+            fb->method = method;
+            incr(method);
+            return fb;
+        }
+
+        slot = (slot + 1) % FEEDBACK_TABLE_SIZE;
+    }
+
+    return NULL;
+}// lookup
+
+
+// Forget everything recorded so far, releasing the table's references.
+void
+feedbackReset(void) {
+    for (int slot = 0; slot < FEEDBACK_TABLE_SIZE; slot++) {
+        struct MethodFeedback *fb = &feedbackTable[slot];
+
+        if (fb->method == nilobj) { continue; }
+
+        for (int n = 0; n < fb->nsites; n++) {
+            struct SiteFeedback *site = &fb->sites[n];
+
+            for (int c = 0; c < site->nclasses && c < FEEDBACK_CLASSES; c++) {
+                decr(site->classes[c]);
+            }
+        }
+        free(fb->sites);
+        decr(fb->method);
+
+        *fb = (struct MethodFeedback) {.method = nilobj};
+    }
+    feedbackCount = 0;
+}// feedbackReset
+
+
+// Find the site at offset in fb, adding it if it's new.
+static struct SiteFeedback *
+findSite(struct MethodFeedback *fb, int offset) {
+    int n;
+
+    for (n = 0; n < fb->nsites && fb->sites[n].offset < offset; n++)
+        ;
+    if (n < fb->nsites && fb->sites[n].offset == offset) {
+        return &fb->sites[n];
+    }
+
+    if (fb->nsites == fb->capacity) {
+        fb->capacity = fb->capacity ? fb->capacity * 2 : 4;
+        fb->sites = ck_realloc(fb->sites,
+                               fb->capacity * sizeof(struct SiteFeedback));
+    }
+
+    memmove(&fb->sites[n + 1], &fb->sites[n],
+            (fb->nsites - n) * sizeof(struct SiteFeedback));
+    fb->nsites++;
+
+    fb->sites[n] = (struct SiteFeedback) {.offset = offset};
+    return &fb->sites[n];
+}// findSite
+
+
+void
+feedbackRecordSend(object method, int offset, object rcvClass) {
+    struct MethodFeedback *fb = lookup(method, TRUE);
+    struct SiteFeedback *site;
+    int n;
+
+    if (!fb) { return; }
+
+    site = findSite(fb, offset);
+    site->count++;
+
+    for (n = 0; n < site->nclasses && n < FEEDBACK_CLASSES; n++) {
+        if (site->classes[n] == rcvClass) { return; }
+    }
+
+    // A new class.  Once the site is megamorphic, we only count them
+    // (and may count one more than once).
+    if (site->nclasses < FEEDBACK_CLASSES) {
+        site->classes[site->nclasses] = rcvClass;
+        incr(rcvClass);
+    }
+    site->nclasses++;
+}// feedbackRecordSend
+
+
+void
+feedbackRecordFailure(object method, int offset) {
+    struct MethodFeedback *fb = lookup(method, TRUE);
+
+    if (fb) {
+        findSite(fb, offset)->failures++;
+    }
+}// feedbackRecordFailure
+
+
+// Counts can easily outgrow a SmallInteger.
+static object
+newCount(long n) {
+    return longCanBeInt(n) ? newInteger(n) : newFloat((double)n);
+}// newCount
+
+
+// Return the feedback for method as an Array with one entry per site,
+// in order of offset, or nil if nothing has been recorded.  Each
+// entry is an Array of:
+//
+//      byte offset just past the send
+//      number of times executed
+//      number of primitive failures
+//      Array of receiver classes seen (at most FEEDBACK_CLASSES)
+//      true if more classes than that were seen, false otherwise
+object
+feedbackFor(object method) {
+    struct MethodFeedback *fb = lookup(method, FALSE);
+    object result;
+
+    if (!fb) { return nilobj; }
+
+    result = newArray(fb->nsites);
+    for (int n = 0; n < fb->nsites; n++) {
+        struct SiteFeedback *site = &fb->sites[n];
+        int nclasses = site->nclasses < FEEDBACK_CLASSES ?
+            site->nclasses : FEEDBACK_CLASSES;
+        object entry = newArray(5);
+        object classes = newArray(nclasses);
+
+        for (int c = 0; c < nclasses; c++) {
+            basicAtPut(classes, c + 1, site->classes[c]);
+        }
+
+        basicAtPut(entry, 1, newInteger(site->offset));
+        basicAtPut(entry, 2, newCount(site->count));
+        basicAtPut(entry, 3, newCount(site->failures));
+        basicAtPut(entry, 4, classes);
+        basicAtPut(entry, 5,
+                   site->nclasses > FEEDBACK_CLASSES ? trueobj : falseobj);
+        basicAtPut(result, n + 1, entry);
+    }
+
+    return result;
+}// feedbackFor
@@ -0,0 +1,15 @@
+/*
+    Type feedback collected at send sites.
+*/
+
+#ifndef __FEEDBACK_H
+#define __FEEDBACK_H
+
+extern boolean feedbackEnabled;
+
+extern void feedbackRecordSend(object method, int offset, object rcvClass);
+extern void feedbackRecordFailure(object method, int offset);
+extern object feedbackFor(object method);
+extern void feedbackReset(void);
+
+#endif
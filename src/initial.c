@@ -11,6 +11,7 @@
 #include "memory.h"
 #include "names.h"
 #include "news.h"
+#include "dict.h"
 #include "parser.h"
 #include "interp.h"
 
@@ -50,6 +51,7 @@ int main(int argc, char **argv) {
 static void
 goDoIt (char *text) {
     object process, stack, method;
+    struct VM *vm;
 
     method = newMethod();
     incr(method);
@@ -76,9 +78,11 @@ goDoIt (char *text) {
     basicAtPut(stack, 6, newInteger(1));	/* byte offset */
 
     /* now go execute it */
-    while (execute(process, 15000)) {
+    vm = newVM();
+    while (execute(vm, process, 15000)) {
         fprintf(stderr, "..");
     }
+    freeVM(vm);
 }
 
 /*
@@ -93,7 +97,7 @@ makeInitialImage (void) {
     /* first create the table, without class links */
     symbols = allocObject(1);
     incr(symbols);
-    hashTable = allocObject(3 * 53);
+    hashTable = allocHashTable(512, FALSE);
     basicAtPut(symbols, 1, hashTable);
 
     /* next create #Symbol, Symbol and Class */
@@ -56,12 +56,48 @@ enum SpecialByteCodes {
 };
 
 
-// These are here because primitives.c needs them; nothing else should
-// ever access these variables.
-extern object processStack;
-extern int linkPointer;
+/* the state of an interpreter.  Everything execute() needs apart
+   from the object memory lives here; primitives that manipulate the
+   running process (block returns, nested execution) get at it too.
+   The object memory, symbols, parser and scheduler are still shared
+   by the whole OS process, so there can't be two VMs running at once
+   in one; more cores are used by forking workers (see worker.c). */
+#define CACHE_SIZE 211
 
-extern void flushCache(object messageToSend, object class);
-extern boolean execute(object aProcess, int maxsteps);
+struct VM {
+    object processStack;    /* stack of the process being run */
+    int linkPointer;        /* its current linkage area */
+
+    object method;          /* method being run */
+    object messageToSend;   /* message being looked up */
+    boolean watching;       /* method watching (primitive 5) on? */
+    int depth;              /* nesting of execute() calls */
+
+    /* a cache of recently executed methods is used for fast lookup */
+    struct {
+        object cacheMessage;	/* the message being requested */
+        object lookupClass;		/* the class of the receiver */
+        object cacheClass;		/* the class of the method */
+        object cacheMethod;		/* the method itself */
+    } methodCache[CACHE_SIZE];
+};
+
+extern struct VM *newVM(void);
+extern void freeVM(struct VM *vm);
+extern void flushCache(struct VM *vm, object messageToSend, object class);
+extern boolean execute(struct VM *vm, object aProcess, int maxsteps);
+
+/* a block called from C, over and over (see blockCallStart()) */
+struct BlockCall {
+    object block;
+    int argc;
+    object process;     /* the nested process it runs in */
+};
+
+extern boolean blockCallStart(struct VM *vm, struct BlockCall *call,
+                              object block, int argc);
+extern object blockCall(struct VM *vm, struct BlockCall *call, object *args,
+                        boolean *ok);
+extern void blockCallEnd(struct BlockCall *call);
 
 #endif
@@ -0,0 +1,807 @@
+/*
+    Little Smalltalk version 3
+    Written by Tim Budd, Oregon State University, July 1988
+
+    The bytecode interpreter loop.
+
+    This file is deliberately NOT protected by an include guard: it is
+    included twice by interp.c to generate two versions of the
+    interpreter from the same source.  Before including it, define:
+
+        EXECUTE_NAME    - the name of the generated function
+        EXECUTE_WATCH   - 1 to compile in support for method watching
+                          (primitive 5), 0 to leave it out entirely
+
+    The watching version is only used while watching is turned on; the
+    production version carries no watch checks at all, so the common
+    case doesn't pay for the debugging feature.
+*/
+
+static boolean
+EXECUTE_NAME (struct VM *vm, object aProcess, int maxsteps) {
+#   define NEXT_BYTE() *(bp + byteOffset++)
+#   define IPUSH(x) incr(*++stackTop=(x))
+
+#   define STACKTOP_PUT(x) decr(*stackTop); incr(*stackTop = (x))
+#   define STACKTOP_FREE() decr(*stackTop); *stackTop-- = nilobj
+
+    // note that IPOP leaves x with excess reference count
+#   define IPOP(x) x = *stackTop; *stackTop-- = nilobj
+
+#   define PROCESS_STACK_TOP() ((stackTop-psb)+1)
+#   define PROCESS_STACK_AT(n) *(psb+(n-1))
+
+#   define RECEIVER_AT(n) *(rcv+n)
+#   define RECEIVER_AT_PUT(n,x) decr(RECEIVER_AT(n)); incr(RECEIVER_AT(n)=(x))
+
+#   define ARGUMENTS_AT(n) *(arg+n)
+
+#   define TEMPORARY_AT(n) *(temps+n)
+#   define TEMPORARY_AT_PUT(n,x) decr(TEMPORARY_AT(n)); incr(TEMPORARY_AT(n)=(x))
+
+#   define LITERALS_AT(n) *(lits+n)
+
+    /* operand of a JOP_RegisterOp */
+#   define JIT_OPERAND(kind, n)                          \
+        ((kind) == BC_PushTemporary ? TEMPORARY_AT(n) : \
+         (kind) == BC_PushArgument  ? ARGUMENTS_AT(n) : \
+         (kind) == BC_PushInstance  ? RECEIVER_AT(n)  : \
+         (kind) == BC_PushLiteral   ? LITERALS_AT(n)  : insn->value)
+
+    /* translated code is only used by the production interpreter */
+#if EXECUTE_WATCH
+#   define JIT_CODE_FOR(m) NULL
+#else
+#   define JIT_CODE_FOR(m) (jitEnabled ? jitCodeFor(m) : NULL)
+#endif
+
+    object returnedObject;
+    int returnPoint, timeSliceCounter;
+    object *stackTop, *psb, *rcv, *arg, *temps, *lits, *cntx;
+    object contextObject, *primargs;
+    int byteOffset;
+    object methodClass, argarray;
+    int i, j;
+    int low;
+    int high;
+    byte *bp;
+    const struct JitInsn *code, *insn;
+
+    /* unpack the instance variables from the process */
+    vm->processStack = basicAt(aProcess, OFST_process_stack);
+    psb = sysMemPtr(vm->processStack);
+    j = intValue(basicAt(aProcess, OFST_process_stackTop));
+    stackTop = psb + (j - 1);
+    vm->linkPointer = intValue(basicAt(aProcess, OFST_process_linkPtr));
+
+    /* set the process time-slice counter before entering loop */
+    timeSliceCounter = maxsteps;
+
+    /* retrieve current values from the linkage area */
+readLinkageBlock:
+    contextObject = PROCESS_STACK_AT(vm->linkPointer + 1);
+    returnPoint = intValue(PROCESS_STACK_AT(vm->linkPointer + 2));
+    byteOffset = intValue(PROCESS_STACK_AT(vm->linkPointer + 4));
+    if (contextObject == nilobj) {
+        contextObject = vm->processStack;
+        cntx = psb;
+        arg = cntx + (returnPoint - 1);
+        vm->method = PROCESS_STACK_AT(vm->linkPointer + 3);
+        temps = cntx + vm->linkPointer + 4;
+    } else {			/* read from context object */
+        cntx = sysMemPtr(contextObject);
+        vm->method = basicAt(contextObject, OFST_context_method);
+        arg = sysMemPtr(basicAt(contextObject, OFST_context_arguments));
+        temps = sysMemPtr(basicAt(contextObject, OFST_context_temporaries));
+    }
+
+    if (!isInteger(ARGUMENTS_AT(0))) {
+        rcv = sysMemPtr(ARGUMENTS_AT(0));
+    }
+    code = JIT_CODE_FOR(vm->method);
+
+readMethodInfo:
+    lits = sysMemPtr(basicAt(vm->method, OFST_method_literals));
+    bp = bytePtr(basicAt(vm->method, OFST_method_bytecodes)) - 1;
+
+    while (--timeSliceCounter > 0) {
+        if (code) {
+            /* translated code has already been decoded */
+            insn = code + byteOffset;
+            byteOffset += insn->length;
+            high = insn->op;
+            low = insn->low;
+        } else {
+            low = (high = NEXT_BYTE()) & 0x0F;
+            high >>= 4;
+            if (high == BC_Extended) {
+                high = low;
+                low = NEXT_BYTE();
+            }
+        }
+        switch (high) {
+
+        case BC_PushInstance:
+            IPUSH(RECEIVER_AT(low));
+            break;
+
+        case BC_PushArgument:
+            IPUSH(ARGUMENTS_AT(low));
+            break;
+
+        case BC_PushTemporary:
+            IPUSH(TEMPORARY_AT(low));
+            break;
+
+        case BC_PushLiteral:
+            IPUSH(LITERALS_AT(low));
+            break;
+
+        case BC_PushConstant:
+            switch (low) {
+            case CC_zero:
+            case CC_one:
+            case CC_two:
+                IPUSH(newInteger(low));
+                break;
+
+            case CC_minusOne:
+                IPUSH(newInteger(-1));
+                break;
+
+            case CC_contextConst:
+                /* check to see if we have made a block context yet */
+                if (contextObject == vm->processStack) {
+                    /* not yet, do it now - first get real return point */
+                    returnPoint =
+                        intValue(PROCESS_STACK_AT(vm->linkPointer + 2));
+                    contextObject =
+                        newContext(vm->linkPointer, vm->method,
+                                   copyFrom(vm->processStack, returnPoint,
+                                            vm->linkPointer - returnPoint),
+                                   copyFrom(vm->processStack,
+                                            vm->linkPointer + 5,
+                                            methodTempSize(vm->method)));
+                    basicAtPut(vm->processStack, vm->linkPointer + 1,
+                               contextObject);
+                    IPUSH(contextObject);
+                    /* save byte pointer then restore things properly */
+                    fieldAtPut(vm->processStack, vm->linkPointer + 4,
+                               newInteger(byteOffset));
+                    goto readLinkageBlock;
+
+                }
+                IPUSH(contextObject);
+                break;
+
+            case CC_nilConst:
+                IPUSH(nilobj);
+                break;
+
+            case CC_trueConst:
+                IPUSH(trueobj);
+                break;
+
+            case CC_falseConst:
+                IPUSH(falseobj);
+                break;
+
+            default:
+                sysError("unimplemented constant", "pushConstant");
+            }
+            break;
+
+        case BC_AssignInstance:
+            RECEIVER_AT_PUT(low, *stackTop);
+            break;
+
+        case BC_AssignTemporary:
+            TEMPORARY_AT_PUT(low, *stackTop);
+            break;
+
+        case BC_MarkArguments:
+            returnPoint = (PROCESS_STACK_TOP() - low) + 1;
+            timeSliceCounter++;	/* make sure we do send */
+            break;
+
+        case BC_SendMessage:
+            vm->messageToSend = LITERALS_AT(low);
+
+doSendMessage:
+            arg = psb + (returnPoint - 1);
+            if (isInteger(ARGUMENTS_AT(0)))
+                /* should fix this later */
+            {
+                methodClass = getClass(ARGUMENTS_AT(0));
+            } else {
+                rcv = sysMemPtr(ARGUMENTS_AT(0));
+                methodClass = classField(ARGUMENTS_AT(0));
+            }
+
+            if (feedbackEnabled) {
+                feedbackRecordSend(vm->method, byteOffset, methodClass);
+            }
+
+            /* the slice timer went off; stop after this send */
+            if (schedTimerExpired) {
+                timeSliceCounter = 0;
+            }
+
+doFindMessage:
+            /* look up method in cache */
+            i = (((int) vm->messageToSend) + ((int) methodClass)) % CACHE_SIZE;
+            if ((vm->methodCache[i].cacheMessage == vm->messageToSend) &&
+                    (vm->methodCache[i].lookupClass == methodClass)) {
+                vm->method = vm->methodCache[i].cacheMethod;
+                methodClass = vm->methodCache[i].cacheClass;
+            } else {
+                vm->methodCache[i].lookupClass = methodClass;
+                if (!findMethod(vm, &methodClass)) {
+                    /* not found, we invoke a smalltalk method */
+                    /* to recover */
+                    j = PROCESS_STACK_TOP() - returnPoint;
+                    argarray = newArray(j + 1);
+                    for (; j >= 0; j--) {
+                        IPOP(returnedObject);
+                        basicAtPut(argarray, j + 1, returnedObject);
+                        decr(returnedObject);
+                    }
+                    IPUSH(basicAt(argarray, 1));	/* push receiver back */
+                    IPUSH(vm->messageToSend);
+                    vm->messageToSend =
+                        newSymbol("message:notRecognizedWithArguments:");
+                    IPUSH(argarray);
+                    /* try again - if fail really give up */
+                    if (!findMethod(vm, &methodClass)) {
+                        sysWarn("can't find", "error recovery method");
+                        /* just quit */
+                        return FALSE;
+                    }
+                }
+                vm->methodCache[i].cacheMessage = vm->messageToSend;
+                vm->methodCache[i].cacheMethod = vm->method;
+                vm->methodCache[i].cacheClass = methodClass;
+            }
+
+#if EXECUTE_WATCH
+            if (vm->watching &&
+                    (basicAt(vm->method, OFST_method_watch) != nilobj)) {
+                /* being watched, we send to method itself */
+                j = PROCESS_STACK_TOP() - returnPoint;
+                argarray = newArray(j + 1);
+                for (; j >= 0; j--) {
+                    IPOP(returnedObject);
+                    basicAtPut(argarray, j + 1, returnedObject);
+                    decr(returnedObject);
+                }
+                IPUSH(vm->method);	/* push method */
+                IPUSH(argarray);
+                vm->messageToSend = newSymbol("watchWith:");
+                /* try again - if fail really give up */
+                rcv = sysMemPtr(vm->method);
+                methodClass = classField(vm->method);
+                if (!findMethod(vm, &methodClass)) {
+                    sysWarn("can't find", "watch method");
+                    /* just quit */
+                    return FALSE;
+                }
+            }
+#endif
+
+            /* save the current byte pointer */
+            fieldAtPut(vm->processStack, vm->linkPointer + 4,
+                       newInteger(byteOffset));
+
+            /* make sure we have enough room in current process */
+            /* stack, if not make stack larger */
+            i = 6 + methodTempSize(vm->method) + methodStackSize(vm->method);
+            j = PROCESS_STACK_TOP();
+            if ((j + i) > sizeField(vm->processStack)) {
+                growProcessStack(vm, i);
+                psb = sysMemPtr(vm->processStack);
+                stackTop = (psb + j);
+            }
+
+            byteOffset = 1;
+            /* now make linkage area */
+            /* position 0 : old linkage pointer */
+            IPUSH(newInteger(vm->linkPointer));
+            vm->linkPointer = PROCESS_STACK_TOP();
+            /* position 1 : context object (nil means stack) */
+            IPUSH(nilobj);
+            contextObject = vm->processStack;
+            cntx = psb;
+            /* position 2 : return point */
+            IPUSH(newInteger(returnPoint));
+            arg = cntx + (returnPoint - 1);
+            /* position 3 : method */
+            IPUSH(vm->method);
+            /* position 4 : bytecode counter */
+            IPUSH(newInteger(byteOffset));
+            /* then make space for temporaries */
+            temps = stackTop + 1;
+            stackTop += methodTempSize(vm->method);
+            /* break if we are too big and probably looping */
+            if (sizeField(vm->processStack) > 1800) {
+                timeSliceCounter = 0;
+            }
+            code = JIT_CODE_FOR(vm->method);
+            goto readMethodInfo;
+
+        case BC_SendUnary:
+            /* do isNil and notNil as special cases, since */
+            /* they are so common */
+#if EXECUTE_WATCH
+            if ((!vm->watching) && (low <= 1)) {
+#else
+            if (low <= 1) {
+#endif
+                if (*stackTop == nilobj) {
+                    STACKTOP_PUT(low ? falseobj : trueobj);
+                    break;
+                }
+            }
+doSendUnary:
+            returnPoint = PROCESS_STACK_TOP();
+            vm->messageToSend = unSyms[low];
+            goto doSendMessage;
+            break;
+
+        case BC_SendBinary:
+            /* optimized as long as arguments are int */
+            /* and conversions are not necessary */
+            /* and overflow does not occur */
+#if EXECUTE_WATCH
+            if ((!vm->watching) && (low <= 12)) {
+#else
+            if (low <= 12) {
+#endif
+                primargs = stackTop - 1;
+                returnedObject = primitive(vm, low + 60, primargs);
+                if (returnedObject != nilobj) {
+                    /* pop arguments off stack , push on result */
+                    STACKTOP_FREE();
+                    STACKTOP_PUT(returnedObject);
+                    break;
+                }
+            }
+            /* else we do it the old fashion way */
+doSendBinary:
+            /* Floats: + - * and comparisons are done here, and the
+               sum, difference or product overwrites the receiver if
+               the stack holds the only reference to it */
+#if EXECUTE_WATCH
+            if ((!vm->watching) && low <= 8 &&
+#else
+            if (low <= 8 &&
+#endif
+                isFloat(*stackTop) && isFloat(*(stackTop - 1))) {
+                object receiver = *(stackTop - 1);
+                double x = floatValue(receiver);
+                double y = floatValue(*stackTop);
+
+                switch (low) {
+                case 0: x += y; break;
+                case 1: x -= y; break;
+                case 8: x *= y; break;
+                case 2: returnedObject = x <  y ? trueobj : falseobj; break;
+                case 3: returnedObject = x >  y ? trueobj : falseobj; break;
+                case 4: returnedObject = x <= y ? trueobj : falseobj; break;
+                case 5: returnedObject = x >= y ? trueobj : falseobj; break;
+                case 6: returnedObject = x == y ? trueobj : falseobj; break;
+                default: returnedObject = x != y ? trueobj : falseobj; break;
+                }
+
+                if (low <= 1 || low == 8) {
+                    if (getObjStruct(receiver)->referenceCount == 1) {
+                        memcpy(charPtr(receiver), &x, sizeof(double));
+                        STACKTOP_FREE();
+                        break;
+                    }
+                    returnedObject = newFloat(x);
+                }
+                STACKTOP_FREE();
+                STACKTOP_PUT(returnedObject);
+                break;
+            }
+
+            returnPoint = PROCESS_STACK_TOP() - 1;
+            vm->messageToSend = binSyms[low];
+            goto doSendMessage;
+
+        case BC_DoPrimitive:
+            /* low gives number of arguments */
+            /* next byte is primitive number */
+            primargs = (stackTop - low) + 1;
+            /* next byte gives primitive number */
+            i = NEXT_BYTE();
+doPrimitive:
+            /* a few primitives are so common, and so easy, that
+               they deserve special treatment */
+            switch (i) {
+            case 5:		/* set watch */
+                /* the other version of the interpreter takes over
+                   at the start of the next time slice */
+                vm->watching = !vm->watching;
+                returnedObject = vm->watching ? trueobj : falseobj;
+                timeSliceCounter = 0;
+                break;
+
+            case 11:		/* class of object */
+                returnedObject = getClass(*primargs);
+                break;
+            case 21:		/* object equality test */
+                if (*primargs == *(primargs + 1)) {
+                    returnedObject = trueobj;
+                } else {
+                    returnedObject = falseobj;
+                }
+                break;
+            case 25:		/* basicAt: */
+                j = intValue(*(primargs + 1));
+                returnedObject = basicAt(*primargs, j);
+                break;
+            case 31:		/* basicAt:Put: */
+                j = intValue(*(primargs + 1));
+                fieldAtPut(*primargs, j, *(primargs + 2));
+                returnedObject = nilobj;
+                break;
+            case 53:		/* set time slice */
+                timeSliceCounter = intValue(*primargs);
+                returnedObject = nilobj;
+                break;
+            case 58:		/* allocObject */
+                j = intValue(*primargs);
+                returnedObject = allocObject(j);
+                break;
+            case 87:		/* value of symbol */
+                returnedObject = globalSymbol(charPtr(*primargs));
+                break;
+            default:
+                returnedObject = primitive(vm, i, primargs);
+                if (feedbackEnabled && returnedObject == nilobj) {
+                    feedbackRecordFailure(vm->method, byteOffset);
+                }
+                /* the primitive blocked or preempted this process */
+                if (schedSwitchPending) {
+                    timeSliceCounter = 0;
+                }
+                break;
+            }
+            /* increment returned object in case pop would destroy it */
+            incr(returnedObject);
+            /* pop off arguments */
+            while (low-- > 0) {
+                STACKTOP_FREE();
+            }
+            /* returned object has already been incremented */
+            IPUSH(returnedObject);
+            decr(returnedObject);
+            break;
+
+doReturn:
+            {
+                object lp = basicAt(vm->processStack, vm->linkPointer);
+
+                returnPoint =
+                    intValue(basicAt(vm->processStack, vm->linkPointer + 2));
+                while (PROCESS_STACK_TOP() >= returnPoint) {
+                    STACKTOP_FREE();
+                }
+                
+                /* returned object has already been incremented */
+                IPUSH(returnedObject);
+                decr(returnedObject);
+                
+                /* now go restart old routine */
+                if (lp != nilobj) {
+                    vm->linkPointer = intValue(lp);
+                    goto readLinkageBlock;
+                } else {
+                    vm->linkPointer = 0;    // Redundant?
+                    return FALSE; /* all done */
+                }
+            }
+
+        case BC_DoSpecial:
+            switch (low) {
+            case SBC_SelfReturn:
+                goto doSelfReturn;
+
+            case SBC_StackReturn:
+                goto doStackReturn;
+
+            case SBC_Duplicate:
+                goto doDuplicate;
+
+            case SBC_PopTop:
+                goto doPopTop;
+
+            case SBC_Branch:
+                /* avoid a subtle bug here */
+                i = NEXT_BYTE();
+doBranch:
+                /* a backward branch is a loop; check the slice timer */
+                if (i < byteOffset && schedTimerExpired) {
+                    timeSliceCounter = 0;
+                }
+                byteOffset = i;
+                break;
+
+            case SBC_BranchIfTrue:
+                i = NEXT_BYTE();
+doBranchIfTrue:
+                IPOP(returnedObject);
+                if (returnedObject == trueobj) {
+                    /* leave nil on stack */
+                    stackTop++;
+                    byteOffset = i;
+                }
+                decr(returnedObject);
+                break;
+
+            case SBC_BranchIfFalse:
+                i = NEXT_BYTE();
+doBranchIfFalse:
+                IPOP(returnedObject);
+                if (returnedObject == falseobj) {
+                    /* leave nil on stack */
+                    stackTop++;
+                    byteOffset = i;
+                }
+                decr(returnedObject);
+                break;
+
+            case SBC_AndBranch:
+                i = NEXT_BYTE();
+doAndBranch:
+                IPOP(returnedObject);
+                if (returnedObject == falseobj) {
+                    IPUSH(returnedObject);
+                    byteOffset = i;
+                }
+                decr(returnedObject);
+                break;
+
+            case SBC_OrBranch:
+                i = NEXT_BYTE();
+doOrBranch:
+                IPOP(returnedObject);
+                if (returnedObject == trueobj) {
+                    IPUSH(returnedObject);
+                    byteOffset = i;
+                }
+                decr(returnedObject);
+                break;
+
+            case SBC_SendToSuper:
+                i = NEXT_BYTE();
+doSendToSuper:
+                vm->messageToSend = LITERALS_AT(i);
+                /* a SmallInteger (say, in mixed arithmetic) has no fields */
+                if (!isInteger(ARGUMENTS_AT(0))) {
+                    rcv = sysMemPtr(ARGUMENTS_AT(0));
+                }
+                methodClass = basicAt(vm->method, OFST_method_methodClass);
+                /* if there is a superclass, use it
+                   otherwise for class Object (the only
+                   class that doesn't have a superclass) use
+                   the class again */
+                returnedObject = basicAt(methodClass, OFST_class_superClass);
+                if (returnedObject != nilobj) {
+                    methodClass = returnedObject;
+                }
+                goto doFindMessage;
+
+            default:
+                sysError("invalid doSpecial", "");
+                break;
+            }
+            break;
+
+        /*
+            Opcodes that only appear in translated code (see jit.c).
+            Most of these share their implementation with the bytecode
+            they were translated from.
+        */
+        case JOP_PushValue:
+            IPUSH(insn->value);
+            break;
+
+        case JOP_IsNil:
+            if (*stackTop == nilobj) {
+                STACKTOP_PUT(trueobj);
+                break;
+            }
+            goto doSendUnary;
+
+        case JOP_NotNil:
+            if (*stackTop == nilobj) {
+                STACKTOP_PUT(falseobj);
+                break;
+            }
+            goto doSendUnary;
+
+        case JOP_Add:
+        case JOP_Sub:
+        case JOP_Mul:
+            /* SmallInteger arithmetic, done inline unless it overflows */
+            if (isInteger(*stackTop) && isInteger(*(stackTop - 1))) {
+                long x = intValue(*(stackTop - 1));
+                long y = intValue(*stackTop);
+
+                x = high == JOP_Add ? x + y :
+                    high == JOP_Sub ? x - y :
+                                      x * y;
+                if (longCanBeInt(x)) {
+                    STACKTOP_FREE();
+                    STACKTOP_PUT(newInteger(x));
+                    break;
+                }
+            }
+            goto doSendBinary;
+
+        case JOP_Lt:
+        case JOP_Gt:
+        case JOP_Le:
+        case JOP_Ge:
+        case JOP_Eq:
+        case JOP_Ne:
+            /* SmallInteger comparisons */
+            if (isInteger(*stackTop) && isInteger(*(stackTop - 1))) {
+                int x = intValue(*(stackTop - 1));
+                int y = intValue(*stackTop);
+                boolean result;
+
+                switch (high) {
+                case JOP_Lt:    result = x <  y; break;
+                case JOP_Gt:    result = x >  y; break;
+                case JOP_Le:    result = x <= y; break;
+                case JOP_Ge:    result = x >= y; break;
+                case JOP_Eq:    result = x == y; break;
+                default:        result = x != y; break;
+                }
+                STACKTOP_FREE();
+                STACKTOP_PUT(result ? trueobj : falseobj);
+                break;
+            }
+            goto doSendBinary;
+
+        case JOP_DoPrimitive:
+            primargs = (stackTop - low) + 1;
+            i = insn->extra;
+            goto doPrimitive;
+
+        case JOP_Branch:
+            i = insn->extra;
+            goto doBranch;
+
+        case JOP_BranchIfTrue:
+            i = insn->extra;
+            goto doBranchIfTrue;
+
+        case JOP_BranchIfFalse:
+            i = insn->extra;
+            goto doBranchIfFalse;
+
+        case JOP_AndBranch:
+            i = insn->extra;
+            goto doAndBranch;
+
+        case JOP_OrBranch:
+            i = insn->extra;
+            goto doOrBranch;
+
+        case JOP_SendToSuper:
+            i = insn->extra;
+            goto doSendToSuper;
+
+        case JOP_SelfReturn:
+doSelfReturn:
+            incr(returnedObject = ARGUMENTS_AT(0));
+            goto doReturn;
+
+        case JOP_StackReturn:
+doStackReturn:
+            IPOP(returnedObject);
+            goto doReturn;
+
+        case JOP_Duplicate:
+doDuplicate:
+            /* avoid possible subtle bug */
+            returnedObject = *stackTop;
+            IPUSH(returnedObject);
+            break;
+
+        case JOP_PopTop:
+doPopTop:
+            IPOP(returnedObject);
+            decr(returnedObject);
+            break;
+
+        case JOP_RegisterOp:
+            /* push a; push b; binop; and maybe assign/pop or branch,
+               with the operands read straight from where they live */
+            {
+                object x = JIT_OPERAND(insn->aKind, insn->a);
+                object y = JIT_OPERAND(insn->bKind, insn->b);
+
+                if (isInteger(x) && isInteger(y)) {
+                    long xv = intValue(x), yv = intValue(y);
+
+                    switch (insn->binop) {
+                    case JOP_Add: xv += yv; goto checkRegisterResult;
+                    case JOP_Sub: xv -= yv; goto checkRegisterResult;
+                    case JOP_Mul: xv *= yv;
+checkRegisterResult:
+                        if (!longCanBeInt(xv)) { goto registerOpSend; }
+                        returnedObject = newInteger(xv);
+                        break;
+                    case JOP_Lt: returnedObject = xv <  yv ? trueobj : falseobj; break;
+                    case JOP_Gt: returnedObject = xv >  yv ? trueobj : falseobj; break;
+                    case JOP_Le: returnedObject = xv <= yv ? trueobj : falseobj; break;
+                    case JOP_Ge: returnedObject = xv >= yv ? trueobj : falseobj; break;
+                    case JOP_Eq: returnedObject = xv == yv ? trueobj : falseobj; break;
+                    default:     returnedObject = xv != yv ? trueobj : falseobj; break;
+                    }
+
+                    switch (insn->store) {
+                    case BC_AssignTemporary:
+                        TEMPORARY_AT_PUT(insn->dest, returnedObject);
+                        break;
+                    case JOP_BranchIfTrue:
+                    case JOP_BranchIfFalse:
+                        if (returnedObject == (insn->store == JOP_BranchIfTrue
+                                               ? trueobj : falseobj)) {
+                            /* leave nil on stack */
+                            IPUSH(nilobj);
+                            byteOffset = insn->extra;
+                        }
+                        break;
+                    default:
+                        IPUSH(returnedObject);
+                        break;
+                    }
+                    break;
+                }
+
+registerOpSend:
+                /* do it the slow way, resuming just after the send */
+                IPUSH(x);
+                IPUSH(y);
+                byteOffset += insn->resume - insn->length;
+                low = insn->low;
+                goto doSendBinary;
+            }
+
+        default:
+            sysError("invalid bytecode", "");
+            break;
+        }
+    }
+
+    /* before returning we put back the values in the current process */
+    /* object */
+
+    fieldAtPut(vm->processStack, vm->linkPointer + 4, newInteger(byteOffset));
+    fieldAtPut(aProcess, OFST_process_stackTop, newInteger(PROCESS_STACK_TOP()));
+    fieldAtPut(aProcess, OFST_process_linkPtr, newInteger(vm->linkPointer));
+
+    return TRUE;
+
+#   undef NEXT_BYTE
+#   undef IPUSH
+#   undef IPOP
+#   undef STACKTOP_PUT
+#   undef STACKTOP_FREE
+#   undef PROCESS_STACK_TOP
+#   undef PROCESS_STACK_AT
+#   undef RECEIVER_AT
+#   undef RECEIVER_AT_PUT
+#   undef ARGUMENTS_AT
+#   undef TEMPORARY_AT
+#   undef TEMPORARY_AT_PUT
+#   undef LITERALS_AT
+#   undef JIT_OPERAND
+#   undef JIT_CODE_FOR
+}
@@ -0,0 +1,346 @@
+/*
+    Baseline translation tier.
+
+    Every time a method is entered, its invocation counter is bumped.
+    Once it passes JIT_THRESHOLD, the method's bytecodes are decoded
+    once and for all into an array of struct JitInsn, indexed by byte
+    offset so that the interpreter's byte counter (which gets saved in
+    contexts, block objects and so on) stays meaningful.  While
+    translating, sends of the common arithmetic selectors are replaced
+    with opcodes that do SmallInteger arithmetic inline, branch and
+    primitive operands are decoded and the special bytecodes are
+    flattened out.
+
+    No native code is generated, so this works wherever the rest of
+    the interpreter does.
+
+    Invocation counts and translated code are kept in a small table
+    keyed on the method, divided into sets of JIT_WAYS entries.  Each
+    entry also counts its recent uses; a method that isn't in its set
+    replaces the entry with the fewest, and every miss halves the
+    counts in the set, so methods that are hot now keep their places
+    (and their invocation counts) while ones that have gone cold,
+    translated or not, make way.
+    The table holds references to both the method and its bytecodes
+    so that neither can be freed (and its slot reused) while an entry
+    refers to it; recompiling a method replaces its bytecodes object,
+    which invalidates the entry.  Code that gets evicted may still be
+    running in an outer invocation of execute(), so it is only freed
+    at the end of the outermost time slice, at which point every
+    process has dropped back to the bytecodes.
+*/
+
+#include <stdio.h>
+
+#include "common.h"
+#include "memory.h"
+#include "names.h"
+#include "interp.h"
+
+#include "jit.h"
+
+struct JitCode {
+    struct JitCode *nextPending;    // link in the list of evicted code
+    struct JitInsn insn[];          // indexed by byte offset (from 1)
+};
+
+static struct {
+    object method;
+    object bytecodes;           // the bytecodes that were translated
+    int count;                  // invocations seen so far
+    unsigned uses;              // recent invocations (see above)
+    const struct JitInsn *insn; // NULL until translated
+    struct JitCode *code;       // the above, if translated at runtime
+} jitTable[JIT_TABLE_SIZE];
+
+static struct JitCode *pendingFree = NULL;
+
+boolean jitEnabled = TRUE;
+
+
+// Map from BC_SendBinary operands to the inline opcodes.
+static const byte binaryOps[] = {
+    JOP_Add, JOP_Sub, JOP_Lt, JOP_Gt, JOP_Le, JOP_Ge, JOP_Eq, JOP_Ne, JOP_Mul
+};
+
+
+// Can in be the operand of a JOP_RegisterOp?  Constants must be
+// SmallIntegers, which need no reference counting.
+static boolean
+isRegisterOperand(const struct JitInsn *in) {
+    return in->op == BC_PushInstance || in->op == BC_PushArgument ||
+        in->op == BC_PushTemporary || in->op == BC_PushLiteral ||
+        (in->op == JOP_PushValue && isInteger(in->value));
+}// isRegisterOperand
+
+
+// Replace each run of "push a; push b; <binop>" with a JOP_RegisterOp
+// at the offset of the first push, also folding in a following
+// "assign t; pop" or, for comparisons, a conditional branch.  The
+// instructions the run replaces are left where they are.
+static void
+fuseRegisterOps(struct JitInsn *insn, int size) {
+    int start, next;
+
+    for (start = 1; start <= size; start = next) {
+        struct JitInsn *a, *b, *op, *after, fused;
+        int offset;
+
+        a = &insn[start];
+        next = start + (a->length ? a->length : 1);
+
+        offset = next;
+        if (offset > size) { break; }
+        b = &insn[offset];
+        offset += b->length;
+        if (offset > size) { break; }
+        op = &insn[offset];
+        offset += op->length;
+
+        if (!isRegisterOperand(a) || !isRegisterOperand(b) ||
+            op->op < JOP_Add || op->op > JOP_Mul ||
+            (a->op == JOP_PushValue && b->op == JOP_PushValue)) {
+            continue;
+        }
+
+        fused = (struct JitInsn) {
+            .op = JOP_RegisterOp,
+            .low = op->low,
+            .value = a->op == JOP_PushValue ? a->value : b->value,
+            .aKind = a->op, .a = a->low,
+            .bKind = b->op, .b = b->low,
+            .binop = op->op,
+            .resume = offset - start,
+        };
+
+        after = offset <= size ? &insn[offset] : NULL;
+        if (after && after->op == BC_AssignTemporary &&
+            offset + after->length <= size &&
+            insn[offset + after->length].op == JOP_PopTop) {
+            fused.store = BC_AssignTemporary;
+            fused.dest = after->low;
+            offset += after->length;
+            offset += insn[offset].length;
+        } else if (after && op->op >= JOP_Lt && op->op <= JOP_Ne &&
+                   (after->op == JOP_BranchIfTrue ||
+                    after->op == JOP_BranchIfFalse)) {
+            fused.store = after->op;
+            fused.extra = after->extra;
+            offset += after->length;
+        }
+
+        fused.length = offset - start;
+        *a = fused;
+    }
+}// fuseRegisterOps
+
+
+// Decode the size bytecodes at bytes into insn[1..size].  Returns
+// FALSE if the bytecodes are malformed (i.e. the last instruction is
+// truncated).  insn[0] and the entries that aren't the start of an
+// instruction are JOP_Invalid.
+static boolean
+jitTranslate (const byte *bytes, int size, struct JitInsn *insn) {
+    const byte *bp = bytes - 1;     // so that bp[1] is the first byte
+    int offset, start, high, low;
+    struct JitInsn *in;
+
+    for (offset = 0; offset <= size; offset++) {
+        insn[offset] = (struct JitInsn) {.op = JOP_Invalid, .value = nilobj};
+    }
+
+    for (offset = 1; offset <= size; ) {
+        start = offset;
+        in = &insn[start];
+
+        low = (high = bp[offset++]) & 0x0F;
+        high >>= 4;
+        if (high == BC_Extended) {
+            if (offset > size) { return FALSE; }
+            high = low;
+            low = bp[offset++];
+        }
+
+        in->op = high;
+        in->low = low;
+
+        switch (high) {
+        case BC_PushConstant:
+            in->op = JOP_PushValue;
+            switch (low) {
+            case CC_zero:
+            case CC_one:
+            case CC_two:        in->value = newInteger(low);    break;
+            case CC_minusOne:   in->value = newInteger(-1);     break;
+            case CC_nilConst:   in->value = nilobj;             break;
+            case CC_trueConst:  in->value = trueobj;            break;
+            case CC_falseConst: in->value = falseobj;           break;
+            default:            in->op = BC_PushConstant;       break;
+            }
+            break;
+
+        case BC_SendUnary:
+            if (low == 0) { in->op = JOP_IsNil; }
+            if (low == 1) { in->op = JOP_NotNil; }
+            break;
+
+        case BC_SendBinary:
+            if (low < sizeof(binaryOps)) { in->op = binaryOps[low]; }
+            break;
+
+        case BC_DoPrimitive:
+            in->op = JOP_DoPrimitive;
+            break;
+
+        case BC_DoSpecial:
+            switch (low) {
+            case SBC_SelfReturn:    in->op = JOP_SelfReturn;    break;
+            case SBC_StackReturn:   in->op = JOP_StackReturn;   break;
+            case SBC_Duplicate:     in->op = JOP_Duplicate;     break;
+            case SBC_PopTop:        in->op = JOP_PopTop;        break;
+            case SBC_Branch:        in->op = JOP_Branch;        break;
+            case SBC_BranchIfTrue:  in->op = JOP_BranchIfTrue;  break;
+            case SBC_BranchIfFalse: in->op = JOP_BranchIfFalse; break;
+            case SBC_AndBranch:     in->op = JOP_AndBranch;     break;
+            case SBC_OrBranch:      in->op = JOP_OrBranch;      break;
+            case SBC_SendToSuper:   in->op = JOP_SendToSuper;   break;
+            default:                in->op = JOP_Invalid;       break;
+            }
+            break;
+        }
+
+        // Pick up the trailing operand byte, if there is one.
+        if (in->op == JOP_DoPrimitive ||
+            (in->op >= JOP_Branch && in->op <= JOP_SendToSuper)) {
+            if (offset > size) { return FALSE; }
+            in->extra = bp[offset++];
+        }
+
+        in->length = offset - start;
+    }
+
+    fuseRegisterOps(insn, size);
+
+    return TRUE;
+}// jitTranslate
+
+
+static struct JitCode *
+translate (object bytecodes) {
+    int size = byteLength(bytecodes);
+    struct JitCode *code;
+
+    code = ck_calloc(1, sizeof(struct JitCode) +
+                     (size + 1) * sizeof(struct JitInsn));
+
+    // A truncated instruction means the bytecodes are malformed;
+    // leave them to the interpreter.
+    if (!jitTranslate(bytePtr(bytecodes), size, code->insn)) {
+        free(code);
+        return NULL;
+    }
+
+    return code;
+}// translate
+
+
+static void
+evict (int slot) {
+    if (jitTable[slot].code) {
+        jitTable[slot].code->nextPending = pendingFree;
+        pendingFree = jitTable[slot].code;
+    }
+
+    decr(jitTable[slot].method);
+    decr(jitTable[slot].bytecodes);
+
+    jitTable[slot].method = nilobj;
+    jitTable[slot].bytecodes = nilobj;
+    jitTable[slot].count = 0;
+    jitTable[slot].uses = 0;
+    jitTable[slot].insn = NULL;
+    jitTable[slot].code = NULL;
+}// evict
+
+
+// Return the entry for method, making one if need be.
+static int
+slotFor(object method) {
+    int first = (oNdx(method) % (JIT_TABLE_SIZE / JIT_WAYS)) * JIT_WAYS;
+    int victim = first;
+
+    for (int slot = first; slot < first + JIT_WAYS; slot++) {
+        if (jitTable[slot].method == method) {
+            return slot;
+        }
+    }
+
+    for (int slot = first; slot < first + JIT_WAYS; slot++) {
+        if (jitTable[slot].uses < jitTable[victim].uses) {
+            victim = slot;
+        }
+        jitTable[slot].uses /= 2;
+    }
+    evict(victim);
+    return victim;
+}// slotFor
+
+
+// Return the translated code for method (indexed by byte offset) or
+// NULL if it hasn't been translated.  This is called whenever the
+// interpreter enters a method, whether by a send or by returning into
+// it; both count toward translating it, since a method that is called
+// once but loops through blocks is entered on every iteration.
+const struct JitInsn *
+jitCodeFor(object method) {
+    object bytecodes = basicAt(method, OFST_method_bytecodes);
+    int slot;
+
+    if (bytecodes == nilobj) {
+        return NULL;
+    }
+
+    slot = slotFor(method);
+    if (jitTable[slot].method != method ||
+        jitTable[slot].bytecodes != bytecodes)
+    {
+        // A new entry, or one whose method has been recompiled.
+        evict(slot);
+        jitTable[slot].method = method;
+        jitTable[slot].bytecodes = bytecodes;
+        incr(method);
+        incr(bytecodes);
+    }
+
+    if (jitTable[slot].uses < UINT_MAX) {
+        jitTable[slot].uses++;
+    }
+
+    if (jitTable[slot].insn) {
+        return jitTable[slot].insn;
+    }
+
+    if (++jitTable[slot].count >= JIT_THRESHOLD) {
+        jitTable[slot].code = translate(bytecodes);
+        if (jitTable[slot].code) {
+            return jitTable[slot].insn = jitTable[slot].code->insn;
+        }
+
+        // Not translatable; don't try again until it's recompiled.
+        jitTable[slot].count = INT_MIN;
+    }
+
+    return NULL;
+}// jitCodeFor
+
+
+// Free code evicted from the table.  Must only be called when no
+// invocation of execute() is running.
+void
+jitReleasePending(void) {
+    while (pendingFree) {
+        struct JitCode *next = pendingFree->nextPending;
+        free(pendingFree);
+        pendingFree = next;
+    }
+}// jitReleasePending
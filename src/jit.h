@@ -0,0 +1,88 @@
+/*
+    Baseline translation tier for the bytecode interpreter.
+
+    Methods that are entered often enough are translated into an array
+    of pre-decoded instructions, one per bytecode, indexed by byte
+    offset.  The interpreter loop (interp_loop.h) runs these instead of
+    decoding the raw bytecodes itself.
+
+    Common runs of stack operations are also fused into register-style
+    instructions that name their operands directly, e.g.
+
+        push t1; push t2; send +; assign t3; pop  =>  ADD t1, t2 -> t3
+
+    The unfused instructions are kept at their own offsets, so jumping
+    into the middle of such a run (or resuming after a send) works.
+*/
+
+#ifndef __JIT_H
+#define __JIT_H
+
+// Opcodes used only by translated code.  These are numbered after
+// the real bytecodes (which fit in a nibble) so both kinds can share
+// the interpreter's dispatch switch.  Ordinary bytecodes that need no
+// special treatment are translated to themselves.
+enum JitOps {
+    JOP_Invalid = 16,       // not the start of an instruction
+
+    JOP_PushValue,          // push insn->value (small int, nil, true, false)
+    JOP_IsNil,              // isNil/notNil with the nil check inline
+    JOP_NotNil,
+
+    // SmallInteger arithmetic and comparison done inline; anything
+    // else falls back to an ordinary binary send.
+    JOP_Add,
+    JOP_Sub,
+    JOP_Lt,
+    JOP_Gt,
+    JOP_Le,
+    JOP_Ge,
+    JOP_Eq,
+    JOP_Ne,
+    JOP_Mul,
+
+    // Bytecodes with a trailing operand byte; the operand is decoded
+    // into insn->extra.
+    JOP_DoPrimitive,
+    JOP_Branch,
+    JOP_BranchIfTrue,
+    JOP_BranchIfFalse,
+    JOP_AndBranch,
+    JOP_OrBranch,
+    JOP_SendToSuper,
+
+    // The remaining special bytecodes, flattened out of BC_DoSpecial.
+    JOP_SelfReturn,
+    JOP_StackReturn,
+    JOP_Duplicate,
+    JOP_PopTop,
+
+    // Fused "push a; push b; <binop> [; assign t; pop | ; branch]".
+    JOP_RegisterOp,
+};
+
+struct JitInsn {
+    byte op;            // a ByteCodes or JitOps value
+    byte length;        // number of bytecode bytes this instruction covers
+    byte low;           // the low operand, as the interpreter decodes it
+    byte extra;         // trailing operand byte, if any
+    object value;       // constant pushed by JOP_PushValue
+
+    // JOP_RegisterOp only:
+    byte aKind, a;      // operands: a push bytecode (or JOP_PushValue for
+    byte bKind, b;      //   'value') and its index
+    byte binop;         // JOP_Add .. JOP_Mul
+    byte store;         // 0 (push the result), BC_AssignTemporary (into
+                        //   temporary 'dest') or JOP_BranchIf{True,False}
+                        //   (to 'extra')
+    byte dest;
+    byte resume;        // length up to and including the send, for when
+                        //   it has to be done the slow way
+};
+
+extern boolean jitEnabled;
+
+extern const struct JitInsn *jitCodeFor(object method);
+extern void jitReleasePending(void);
+
+#endif
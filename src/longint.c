@@ -0,0 +1,677 @@
+/*
+    Arbitrary-precision integers, for LongInteger.
+
+    A LongInteger is a byte object holding its magnitude as 32-bit
+    limbs, least significant first, followed by one byte that is
+    nonzero if it is negative.  (Byte objects' memory comes straight
+    from calloc(), so the limbs are suitably aligned.)  Arithmetic
+    results that fit in a SmallInteger are returned as SmallIntegers;
+    only asLongInteger makes a small LongInteger, for mixed arithmetic.
+
+    Primitives 240-249 do all the arithmetic here on plain limb arrays:
+    schoolbook multiplication for short operands and Karatsuba above
+    KARATSUBA_THRESHOLD limbs, Knuth's algorithm D for division.  Each
+    primitive accepts SmallIntegers as well, and fails (returns nil)
+    for anything else or a result too big for a byte object.
+    intBinary() (see primitive.c) calls longIntegerFrom() when
+    SmallInteger arithmetic overflows.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "common.h"
+#include "memory.h"
+#include "names.h"
+#include "news.h"
+#include "tty.h"
+
+#include "bulk.h"
+#include "longint.h"
+
+typedef uint32_t limb;
+
+enum {
+    LIMB_BITS = 32,
+    KARATSUBA_THRESHOLD = 32,   // limbs; shorter products are done directly
+};
+
+// An integer being worked on: its magnitude as limbs and its sign.
+// The limbs belong to a LongInteger or to 'small' and are only read.
+struct Big {
+    const limb *limbs;
+    int count;                  // no high zero limbs; 0 for zero
+    boolean negative;
+    limb small[2];
+};
+
+static object longClass = 0;
+
+static void
+findClass(void) {
+    if (longClass == nilobj) {
+        longClass = globalSymbol("LongInteger");
+    }
+}// findClass
+
+
+static inline int
+trimmed(const limb *limbs, int count) {
+    while (count > 0 && limbs[count - 1] == 0) { count--; }
+    return count;
+}// trimmed
+
+// The most limbs a LongInteger can hold.
+static inline int
+maxLimbs(void) {
+    return (OBJSIZE_MAX - 2) / sizeof(limb);
+}// maxLimbs
+
+static inline limb *
+newLimbs(int count) {
+    return ck_calloc(count > 0 ? count : 1, sizeof(limb));
+}// newLimbs
+
+// Set b to x, a SmallInteger or LongInteger.  Returns FALSE if x is
+// neither.
+static boolean
+toBig(object x, struct Big *b) {
+    int count;
+
+    findClass();
+    if (isInteger(x)) {
+        long value = intValue(x);
+
+        b->small[0] = value < 0 ? -(unsigned long)value : (unsigned long)value;
+        b->small[1] = 0;
+        b->limbs = b->small;
+        b->count = b->small[0] != 0;
+        b->negative = value < 0;
+        return TRUE;
+    }
+
+    if (!isIndexed(x) || classField(x) != longClass || sizeField(x) >= 0 ||
+            (byteLength(x) - 1) % sizeof(limb) != 0) {
+        return FALSE;
+    }
+    count = (byteLength(x) - 1) / sizeof(limb);
+    b->limbs = (const limb *) bytePtr(x);
+    b->count = trimmed(b->limbs, count);
+    b->negative = bytePtr(x)[count * sizeof(limb)] != 0 && b->count > 0;
+    return TRUE;
+}// toBig
+
+// Return the integer with this magnitude and sign: a SmallInteger if
+// it fits (and normalize is set), otherwise a new LongInteger.  Returns
+// nil if it is too big.
+static object
+fromLimbs(const limb *limbs, int count, boolean negative, boolean normalize) {
+    object result;
+
+    count = trimmed(limbs, count);
+    if (count == 0) {
+        negative = FALSE;
+    }
+    if (normalize && count <= 1 &&
+            (count == 0 || limbs[0] <= (limb) OBJINT_MAX + negative)) {
+        long value = count ? limbs[0] : 0;
+
+        return newInteger(negative ? -value : value);
+    }
+    if (count > maxLimbs()) {
+        return nilobj;
+    }
+
+    findClass();
+    result = allocByte(count * sizeof(limb) + 1);
+    setClass(result, longClass);
+    memcpy(bytePtr(result), limbs, count * sizeof(limb));
+    bytePtr(result)[count * sizeof(limb)] = negative;
+    return result;
+}// fromLimbs
+
+// Return value as a SmallInteger if it fits, else as a LongInteger.
+object
+longIntegerFrom(long value) {
+    uint64_t magnitude = value < 0 ? -(uint64_t)value : (uint64_t)value;
+    limb limbs[2];
+
+    limbs[0] = (limb) magnitude;
+    limbs[1] = (limb) (magnitude >> LIMB_BITS);
+    return fromLimbs(limbs, 2, value < 0, TRUE);
+}// longIntegerFrom
+
+
+/*
+    Magnitudes.  These work on limb arrays; a result array must have
+    room for the count given and may have high zero limbs.
+*/
+
+static int
+magCompare(const limb *a, int na, const limb *b, int nb) {
+    if (na != nb) {
+        return na < nb ? -1 : 1;
+    }
+    for (int i = na - 1; i >= 0; i--) {
+        if (a[i] != b[i]) {
+            return a[i] < b[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}// magCompare
+
+// r = a + b, in max(na, nb) + 1 limbs.  Returns that count.
+static int
+magAdd(limb *r, const limb *a, int na, const limb *b, int nb) {
+    uint64_t carry = 0;
+    int i;
+
+    if (na < nb) {
+        const limb *t = a; a = b; b = t;
+        int n = na; na = nb; nb = n;
+    }
+    for (i = 0; i < nb; i++) {
+        carry += (uint64_t) a[i] + b[i];
+        r[i] = (limb) carry;
+        carry >>= LIMB_BITS;
+    }
+    for (; i < na; i++) {
+        carry += a[i];
+        r[i] = (limb) carry;
+        carry >>= LIMB_BITS;
+    }
+    r[na] = (limb) carry;
+    return na + 1;
+}// magAdd
+
+// r = a - b, in na limbs, where a >= b.
+static void
+magSub(limb *r, const limb *a, int na, const limb *b, int nb) {
+    uint64_t borrow = 0;
+    int i;
+
+    for (i = 0; i < nb; i++) {
+        uint64_t d = (uint64_t) a[i] - b[i] - borrow;
+        r[i] = (limb) d;
+        borrow = (d >> LIMB_BITS) & 1;
+    }
+    for (; i < na; i++) {
+        uint64_t d = (uint64_t) a[i] - borrow;
+        r[i] = (limb) d;
+        borrow = (d >> LIMB_BITS) & 1;
+    }
+}// magSub
+
+// r += a, where r has nr limbs and the sum fits in them.
+static void
+addInto(limb *r, int nr, const limb *a, int na) {
+    uint64_t carry = 0;
+
+    for (int i = 0; i < nr && (i < na || carry); i++) {
+        carry += (uint64_t) r[i] + (i < na ? a[i] : 0);
+        r[i] = (limb) carry;
+        carry >>= LIMB_BITS;
+    }
+}// addInto
+
+// r -= a, where r has nr limbs and is at least a.
+static void
+subFrom(limb *r, int nr, const limb *a, int na) {
+    uint64_t borrow = 0;
+
+    for (int i = 0; i < nr && (i < na || borrow); i++) {
+        uint64_t d = (uint64_t) r[i] - (i < na ? a[i] : 0) - borrow;
+        r[i] = (limb) d;
+        borrow = (d >> LIMB_BITS) & 1;
+    }
+}// subFrom
+
+static void
+mulBasic(limb *r, const limb *a, int na, const limb *b, int nb) {
+    memset(r, 0, (na + nb) * sizeof(limb));
+    for (int i = 0; i < na; i++) {
+        uint64_t carry = 0;
+
+        for (int j = 0; j < nb; j++) {
+            carry += (uint64_t) a[i] * b[j] + r[i + j];
+            r[i + j] = (limb) carry;
+            carry >>= LIMB_BITS;
+        }
+        r[i + nb] = (limb) carry;
+    }
+}// mulBasic
+
+// r = a * b, in na + nb limbs.  r must not overlap a or b.
+static void
+magMul(limb *r, const limb *a, int na, const limb *b, int nb) {
+    int m, na1, nb1, nsa, nsb;
+    limb *sa, *sb, *z1;
+
+    if (na < nb) {
+        const limb *t = a; a = b; b = t;
+        int n = na; na = nb; nb = n;
+    }
+    if (nb < KARATSUBA_THRESHOLD) {
+        mulBasic(r, a, na, b, nb);
+        return;
+    }
+
+    m = na / 2;
+    if (nb <= m) {
+        // b is too short to split: r = a0 * b + (a1 * b) << m.
+        limb *t = newLimbs(na - m + nb);
+
+        magMul(r, a, m, b, nb);
+        memset(r + m + nb, 0, (na - m) * sizeof(limb));
+        magMul(t, a + m, na - m, b, nb);
+        addInto(r + m, na + nb - m, t, na - m + nb);
+        free(t);
+        return;
+    }
+
+    // a = a1 << m + a0, b = b1 << m + b0.  Then
+    // a * b = z2 << 2m + z1 << m + z0, where z0 = a0 * b0,
+    // z2 = a1 * b1 and z1 = (a0 + a1) * (b0 + b1) - z0 - z2.
+    na1 = na - m;
+    nb1 = nb - m;
+    magMul(r, a, m, b, m);
+    magMul(r + 2 * m, a + m, na1, b + m, nb1);
+
+    sa = newLimbs(na1 + 1);
+    sb = newLimbs((nb1 > m ? nb1 : m) + 1);
+    nsa = magAdd(sa, a + m, na1, a, m);
+    nsb = magAdd(sb, b + m, nb1, b, m);
+    z1 = newLimbs(nsa + nsb);
+    magMul(z1, sa, nsa, sb, nsb);
+    subFrom(z1, nsa + nsb, r, 2 * m);
+    subFrom(z1, nsa + nsb, r + 2 * m, na1 + nb1);
+    addInto(r + m, na + nb - m, z1, trimmed(z1, nsa + nsb));
+
+    free(sa);
+    free(sb);
+    free(z1);
+}// magMul
+
+// q = a / d, in na limbs; returns the remainder.
+static limb
+divSmall(limb *q, const limb *a, int na, limb d) {
+    uint64_t rem = 0;
+
+    for (int i = na - 1; i >= 0; i--) {
+        uint64_t cur = (rem << LIMB_BITS) | a[i];
+
+        q[i] = (limb) (cur / d);
+        rem = cur % d;
+    }
+    return (limb) rem;
+}// divSmall
+
+// q = a / b in na - nb + 1 limbs and r = a % b in nb limbs, where
+// na >= nb > 0 and b has no high zero limb.  This is Knuth's algorithm
+// D, as given in Hacker's Delight.
+static void
+magDivide(limb *q, limb *r, const limb *a, int na, const limb *b, int nb) {
+    limb *un, *vn;
+    int s = 0;
+
+    if (nb == 1) {
+        r[0] = divSmall(q, a, na, b[0]);
+        return;
+    }
+
+    // Shift b left until its top bit is set, and a with it.
+    for (limb top = b[nb - 1]; !(top & 0x80000000u); top <<= 1) { s++; }
+    vn = newLimbs(nb);
+    un = newLimbs(na + 1);
+    for (int i = nb - 1; i > 0; i--) {
+        vn[i] = (b[i] << s) | (s ? b[i - 1] >> (LIMB_BITS - s) : 0);
+    }
+    vn[0] = b[0] << s;
+    un[na] = s ? a[na - 1] >> (LIMB_BITS - s) : 0;
+    for (int i = na - 1; i > 0; i--) {
+        un[i] = (a[i] << s) | (s ? a[i - 1] >> (LIMB_BITS - s) : 0);
+    }
+    un[0] = a[0] << s;
+
+    for (int j = na - nb; j >= 0; j--) {
+        uint64_t num = ((uint64_t) un[j + nb] << LIMB_BITS) | un[j + nb - 1];
+        uint64_t qhat = num / vn[nb - 1];
+        uint64_t rhat = num % vn[nb - 1];
+        int64_t t, k = 0;
+
+        while (qhat >> LIMB_BITS ||
+               qhat * vn[nb - 2] > ((rhat << LIMB_BITS) | un[j + nb - 2])) {
+            qhat--;
+            rhat += vn[nb - 1];
+            if (rhat >> LIMB_BITS) { break; }
+        }
+
+        // Multiply and subtract; add back if that went negative.
+        for (int i = 0; i < nb; i++) {
+            uint64_t p = qhat * vn[i];
+
+            t = (int64_t) un[i + j] - k - (int64_t) (p & 0xFFFFFFFFu);
+            un[i + j] = (limb) t;
+            k = (int64_t) (p >> LIMB_BITS) - (t >> LIMB_BITS);
+        }
+        t = (int64_t) un[j + nb] - k;
+        un[j + nb] = (limb) t;
+
+        q[j] = (limb) qhat;
+        if (t < 0) {
+            uint64_t carry = 0;
+
+            q[j]--;
+            for (int i = 0; i < nb; i++) {
+                carry += (uint64_t) un[i + j] + vn[i];
+                un[i + j] = (limb) carry;
+                carry >>= LIMB_BITS;
+            }
+            un[j + nb] += (limb) carry;
+        }
+    }
+
+    for (int i = 0; i < nb; i++) {
+        r[i] = (un[i] >> s) | (s ? un[i + 1] << (LIMB_BITS - s) : 0);
+    }
+
+    free(un);
+    free(vn);
+}// magDivide
+
+
+/*
+    Signed arithmetic on Bigs.
+*/
+
+static object
+bigAdd(const struct Big *a, const struct Big *b) {
+    int n = (a->count > b->count ? a->count : b->count) + 1;
+    limb *r = newLimbs(n);
+    boolean negative = a->negative;
+    object result;
+
+    if (a->negative == b->negative) {
+        magAdd(r, a->limbs, a->count, b->limbs, b->count);
+    } else if (magCompare(a->limbs, a->count, b->limbs, b->count) >= 0) {
+        magSub(r, a->limbs, a->count, b->limbs, b->count);
+    } else {
+        magSub(r, b->limbs, b->count, a->limbs, a->count);
+        negative = b->negative;
+    }
+
+    result = fromLimbs(r, n, negative, TRUE);
+    free(r);
+    return result;
+}// bigAdd
+
+static object
+bigMul(const struct Big *a, const struct Big *b) {
+    limb *r;
+    object result;
+
+    if (a->count + b->count > maxLimbs() + 1) {
+        return nilobj;
+    }
+    r = newLimbs(a->count + b->count);
+    magMul(r, a->limbs, a->count, b->limbs, b->count);
+    result = fromLimbs(r, a->count + b->count, a->negative != b->negative, TRUE);
+    free(r);
+    return result;
+}// bigMul
+
+// Return a quo: b, or a rem: b if remainder is set; both truncate
+// towards zero.  b must not be zero.
+static object
+bigDivide(const struct Big *a, const struct Big *b, boolean remainder) {
+    limb *q, *r;
+    object result;
+
+    if (a->count < b->count) {
+        return remainder
+            ? fromLimbs(a->limbs, a->count, a->negative, TRUE)
+            : newInteger(0);
+    }
+
+    q = newLimbs(a->count - b->count + 1);
+    r = newLimbs(b->count);
+    magDivide(q, r, a->limbs, a->count, b->limbs, b->count);
+    result = remainder
+        ? fromLimbs(r, b->count, a->negative, TRUE)
+        : fromLimbs(q, a->count - b->count + 1,
+                    a->negative != b->negative, TRUE);
+    free(q);
+    free(r);
+    return result;
+}// bigDivide
+
+static int
+bigCompare(const struct Big *a, const struct Big *b) {
+    int cmp;
+
+    if (a->negative != b->negative) {
+        return a->negative ? -1 : 1;
+    }
+    cmp = magCompare(a->limbs, a->count, b->limbs, b->count);
+    return a->negative ? -cmp : cmp;
+}// bigCompare
+
+// The greatest common divisor of a and b, by Euclid's algorithm.
+static object
+bigGcd(const struct Big *a, const struct Big *b) {
+    int size = (a->count > b->count ? a->count : b->count) + 1;
+    limb *x = newLimbs(size), *y = newLimbs(size), *r = newLimbs(size);
+    limb *q = newLimbs(size);
+    int nx = a->count, ny = b->count;
+    object result;
+
+    memcpy(x, a->limbs, nx * sizeof(limb));
+    memcpy(y, b->limbs, ny * sizeof(limb));
+    while (ny > 0) {
+        limb *t;
+
+        if (magCompare(x, nx, y, ny) < 0) {
+            memset(r, 0, size * sizeof(limb));
+            memcpy(r, x, nx * sizeof(limb));
+        } else {
+            magDivide(q, r, x, nx, y, ny);
+        }
+        t = x; x = y; y = r; r = t;
+        nx = ny;
+        ny = trimmed(y, ny);
+    }
+
+    result = fromLimbs(x, nx, FALSE, TRUE);
+    free(x);
+    free(y);
+    free(r);
+    free(q);
+    return result;
+}// bigGcd
+
+// Return a shifted left (or right, if shift is negative) by shift
+// bits.  A right shift rounds towards negative infinity, as it does
+// for SmallIntegers.
+static object
+bigShift(const struct Big *a, int shift) {
+    int words = (shift < 0 ? -shift : shift) / LIMB_BITS;
+    int bits = (shift < 0 ? -shift : shift) % LIMB_BITS;
+    limb *r;
+    int n;
+    object result;
+
+    if (shift >= 0) {
+        if (a->count + words + 1 > maxLimbs() + 1) {
+            return a->count == 0 ? newInteger(0) : nilobj;
+        }
+        n = a->count + words + 1;
+        r = newLimbs(n);
+        for (int i = 0; i < a->count; i++) {
+            r[i + words] |= a->limbs[i] << bits;
+            r[i + words + 1] = bits ? a->limbs[i] >> (LIMB_BITS - bits) : 0;
+        }
+    } else {
+        boolean lost = FALSE;
+        limb one = 1;
+
+        if (words >= a->count) {
+            return newInteger(a->negative ? -1 : 0);
+        }
+        n = a->count - words + 1;
+        r = newLimbs(n);
+        for (int i = 0; i < words; i++) {
+            lost = lost || a->limbs[i] != 0;
+        }
+        lost = lost || (bits && (a->limbs[words] << (LIMB_BITS - bits)) != 0);
+        for (int i = words; i < a->count; i++) {
+            r[i - words] = (a->limbs[i] >> bits) |
+                (bits && i + 1 < a->count
+                     ? a->limbs[i + 1] << (LIMB_BITS - bits) : 0);
+        }
+        if (a->negative && lost) {
+            addInto(r, n, &one, 1);
+        }
+    }
+
+    result = fromLimbs(r, n, a->negative, TRUE);
+    free(r);
+    return result;
+}// bigShift
+
+object
+longIntegerShift(object x, int shift) {
+    struct Big a;
+
+    return toBig(x, &a) ? bigShift(&a, shift) : nilobj;
+}// longIntegerShift
+
+// Return a printed in base (2-36) as a String, with digits as
+// Integer>>asDigit makes them.
+static object
+bigPrint(const struct Big *a, int base) {
+    static const char digitChars[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    limb *q = newLimbs(a->count);
+    int n = a->count;
+    int size = n * LIMB_BITS + 2;
+    char *text = ck_calloc(size + 1, 1);
+    char *p = text + size;
+    limb chunk = base;
+    int chunkDigits = 1;
+    object result = nilobj;
+
+    // Divide by the largest power of base that fits in a limb at a
+    // time, giving chunkDigits digits each.
+    while ((uint64_t) chunk * base <= 0xFFFFFFFFu) {
+        chunk *= base;
+        chunkDigits++;
+    }
+
+    memcpy(q, a->limbs, n * sizeof(limb));
+    do {
+        limb rem = divSmall(q, q, n, chunk);
+
+        n = trimmed(q, n);
+        for (int i = 0; i < chunkDigits && (n > 0 || rem > 0); i++) {
+            *--p = digitChars[rem % base];
+            rem /= base;
+        }
+    } while (n > 0);
+    if (p == text + size) { *--p = '0'; }
+    if (a->negative) { *--p = '-'; }
+
+    if (text + size - p < OBJSIZE_MAX - 1) {
+        result = newStString(p);
+    }
+    free(text);
+    free(q);
+    return result;
+}// bigPrint
+
+static double
+bigToDouble(const struct Big *a) {
+    double d = 0.0;
+
+    for (int i = a->count - 1; i >= 0; i--) {
+        d = d * 4294967296.0 + a->limbs[i];
+    }
+    return a->negative ? -d : d;
+}// bigToDouble
+
+
+// Primitives 240-249.
+object
+longIntegerPrimitive(int number, object *arguments) {
+    object returnedObject = nilobj;
+    struct Big a, b;
+
+    if (!toBig(arguments[0], &a)) {
+        return nilobj;
+    }
+
+    switch (number) {
+    case 0:         /* + */
+    case 1:         /* - */
+        if (toBig(arguments[1], &b)) {
+            if (number == 1) {
+                b.negative = !b.negative && b.count > 0;
+            }
+            returnedObject = bigAdd(&a, &b);
+        }
+        break;
+
+    case 2:         /* * */
+        if (toBig(arguments[1], &b)) {
+            returnedObject = bigMul(&a, &b);
+        }
+        break;
+
+    case 3:         /* quo: or, if the third argument is true, rem: */
+        if (toBig(arguments[1], &b) && b.count > 0) {
+            returnedObject = bigDivide(&a, &b, arguments[2] == trueobj);
+        }
+        break;
+
+    case 4:         /* compare: -1, 0 or 1 */
+        if (toBig(arguments[1], &b)) {
+            returnedObject = newInteger(bigCompare(&a, &b));
+        }
+        break;
+
+    case 5:         /* gcd: */
+        if (toBig(arguments[1], &b)) {
+            returnedObject = bigGcd(&a, &b);
+        }
+        break;
+
+    case 6:         /* bitShift: */
+        if (isInteger(arguments[1])) {
+            returnedObject = bigShift(&a, intValue(arguments[1]));
+        }
+        break;
+
+    case 7:         /* radix: */
+        if (isInteger(arguments[1]) && intValue(arguments[1]) >= 2 &&
+            intValue(arguments[1]) <= 36) {
+            returnedObject = bigPrint(&a, intValue(arguments[1]));
+        }
+        break;
+
+    case 8:         /* asFloat */
+        returnedObject = newFloat(bigToDouble(&a));
+        break;
+
+    case 9:         /* asLongInteger */
+        returnedObject = isInteger(arguments[0])
+            ? fromLimbs(a.limbs, a.count, a.negative, FALSE)
+            : arguments[0];
+        break;
+
+    default:
+        sysError("unknown primitive", "longIntegerPrimitive");
+        break;
+    }
+
+    return returnedObject;
+}// longIntegerPrimitive
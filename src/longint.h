@@ -0,0 +1,12 @@
+/*
+    Native arbitrary-precision integers, for LongInteger.
+*/
+
+#ifndef __LONGINT_H
+#define __LONGINT_H
+
+extern object longIntegerFrom(long value);
+extern object longIntegerShift(object x, int shift);
+extern object longIntegerPrimitive(int number, object *arguments);
+
+#endif
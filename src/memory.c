@@ -84,6 +84,75 @@ static int byteSize(int size) {
     return size < 0 ? -size : size * sizeof(object);
 }
 
+
+/*
+    Recycled memory for small pointer objects.  Contexts, argument and
+    temporary arrays and process stacks are allocated and freed at a
+    great rate and come in only a few sizes, so freed memory blocks are
+    kept here by size (in slots) and handed out again instead of going
+    through calloc() and free() each time.
+*/
+
+static struct {
+    int count;
+    object *blocks[MEMORY_POOL_DEPTH];
+} memoryPool[MEMORY_POOL_SLOTS + 1];
+
+// Return zeroed memory for an object whose size field is 'size'.
+static object *
+newMemory(size_int size) {
+    if (size > 0 && size <= MEMORY_POOL_SLOTS && memoryPool[size].count) {
+        object *mem = memoryPool[size].blocks[--memoryPool[size].count];
+        memset(mem, 0, byteSize(size) * sizeof(object));
+        return mem;
+    }
+
+    return ck_calloc(byteSize(size), sizeof(object));
+}// newMemory
+
+// Release the memory of ob.  Only pointer objects are recycled since
+// byte objects' memory may have been resized (see setStringValue()).
+static void
+freeMemory(struct objectStruct *ob) {
+    int size = ob->size;
+
+    if (size > 0 && size <= MEMORY_POOL_SLOTS &&
+        memoryPool[size].count < MEMORY_POOL_DEPTH) {
+        memoryPool[size].blocks[memoryPool[size].count++] = ob->memory;
+        return;
+    }
+
+    free(ob->memory);
+}// freeMemory
+
+
+/*
+    Recycled Floats.  Float arithmetic makes a new object for every
+    result and frees most of them again almost at once, so freed Floats
+    are kept here whole--table slot, memory and class--with a reference
+    count of 0, and newFloat() takes them back before allocating.
+*/
+
+static struct {
+    int count;
+    object floats[FLOAT_POOL_DEPTH];
+} floatPool;
+
+static inline boolean
+isRecyclableFloat(struct objectStruct *ob) {
+    return ob->class == floatClass && floatClass != nilobj &&
+        ob->size == -(int) (sizeof(double) + 1) &&
+        floatPool.count < FLOAT_POOL_DEPTH;
+}// isRecyclableFloat
+
+// Return a freed Float whose value may be overwritten, or nil if there
+// are none.
+object
+recycledFloat(void) {
+    return floatPool.count ? floatPool.floats[--floatPool.count] : nilobj;
+}// recycledFloat
+
+
 static void
 addToFreeList(object x) {
     assert(ObjectTable[oNdx(x)].memory == NULL);
@@ -93,6 +162,27 @@ addToFreeList(object x) {
 }
 
 
+static void
+clearObjectStruct(struct objectStruct *ob) {
+    if (ob->memory) { freeMemory(ob); }
+    ob->memory = NULL;
+    ob->size = 0;
+    ob->referenceCount = 0;
+    ob->class = 0;
+}
+
+// Give the slots of the recycled Floats back, for when there are no
+// others left.
+static void
+emptyFloatPool(void) {
+    while (floatPool.count) {
+        object z = floatPool.floats[--floatPool.count];
+        clearObjectStruct(&ObjectTable[oNdx(z)]);
+        addToFreeList(z);
+    }
+}// emptyFloatPool
+
+
 /* initialize the memory management module */
 void
 initMemoryManager (void) {
@@ -116,6 +206,10 @@ allocObject (size_int memorySize) {
         sysError("New object size exceeds maximum.", "");
     }
     
+    if (freeListHead < 0 && lastObject + 1 >= OBJECT_TABLE_MAX) {
+        emptyFloatPool();
+    }
+
     if (freeListHead < 0) {
         ++lastObject;
         if (lastObject >= OBJECT_TABLE_MAX) {
@@ -133,7 +227,7 @@ allocObject (size_int memorySize) {
     ob->class           = nilobj;
     ob->referenceCount  = 0;
     ob->size            = memorySize;
-    ob->memory          = ck_calloc(byteSize(memorySize), sizeof(object));
+    ob->memory          = newMemory(memorySize);
     
     return newSlot << 1;
 }
@@ -142,10 +236,15 @@ object
 allocByte (size_int size) {
     object newObj;
 
-    newObj = allocObject(size);
+    if (size + 1 > OBJSIZE_MAX) {
+        sysError("New object size exceeds maximum.", "");
+    }
+
+    // Room for size bytes and the terminating 0 (see byteLength()).
+    newObj = allocObject(size / sizeof(object) + 1);
 
     /* negative size fields indicate bit objects */
-    ObjectTable[oNdx(newObj)].size = -size;
+    ObjectTable[oNdx(newObj)].size = -(size + 1);
 
     return newObj;
 }// allocByte 
@@ -153,24 +252,16 @@ allocByte (size_int size) {
 object
 allocStr (char *str) {
     object newSym;
+    size_t len = strlen(str);
 
-    assert(strlen(str) + 1 < OBJSIZE_MAX);
+    assert(len + 1 < OBJSIZE_MAX);
     
-    newSym = allocByte(1 + (size_int)strlen(str));
-    strcpy(charPtr(newSym), str);
+    newSym = allocByte((size_int)len);
+    memcpy(charPtr(newSym), str, len);
     return (newSym);
 }// allocStr 
 
 
-static void
-clearObjectStruct(struct objectStruct *ob) {
-    if (ob->memory) { free(ob->memory); }
-    ob->memory = NULL;
-    ob->size = 0;
-    ob->referenceCount = 0;
-    ob->class = 0;
-}
-
 /* do the real work in the decr procedure */
 void
 sysDecr(object z) {
@@ -178,6 +269,11 @@ sysDecr(object z) {
     assert(ob->referenceCount == 0);
     assert(ob->size == 0 || ob->memory);
 
+    if (isRecyclableFloat(ob)) {
+        floatPool.floats[floatPool.count++] = z;
+        return;
+    }
+
     // Deref the fields if this is a ref object
     for (int n = 0; n < ob->size; n++) {
         decr(ob->memory[n]);
@@ -194,7 +290,7 @@ byteAtPut (object z, int i, int x) {
 
     if (isInteger(z)) {
         sysError("indexing integer", "byteAtPut");
-    } else if ((i <= 0) || (i > 2 * -sizeField(z))) {
+    } else if ((i <= 0) || (i > byteLength(z))) {
         fprintf(stderr, "index %d size %d\n", i, sizeField(z));
         sysError("index out of range", "byteAtPut");
     } else {
@@ -203,6 +299,22 @@ byteAtPut (object z, int i, int x) {
     }
 }
 
+// Add slots (initially nil) to the end of pointer object x, keeping
+// the object itself and its contents; no reference counts change.
+void
+growObject(object x, size_int newSize) {
+    struct objectStruct *ob = &ObjectTable[oNdx(x)];
+
+    assert(ob->size >= 0 && newSize >= ob->size);
+    if (newSize > OBJSIZE_MAX) {
+        sysError("New object size exceeds maximum.", "");
+    }
+
+    ob->memory = ck_realloc(ob->memory, byteSize(newSize) * sizeof(object));
+    memset(ob->memory + ob->size, 0, (newSize - ob->size) * sizeof(object));
+    ob->size = newSize;
+}// growObject
+
 // Change the value of an existing string object.  Possibly a hack.
 void
 setStringValue(object x, const char *str) {
@@ -358,7 +470,13 @@ struct DummyObject {
 void
 imageRead(FILE * fp) {
     struct DummyObject dummyObject;
+    int32_t version = 0;
 
+    if (!fread_chk(fp, (char *) &version, sizeof(version)) ||
+        version != IMAGE_VERSION) {
+        sysError("image is from another version of the VM",
+                 "rebuild it with buildImage");
+    }
     fread_chk(fp, (char *) &symbols, sizeof(object));
 
     while (fread_chk(fp, (char *) &dummyObject, sizeof(dummyObject))) {
@@ -398,7 +516,9 @@ imageRead(FILE * fp) {
 void
 imageWrite(FILE * fp) {
     struct DummyObject dummyObject;
+    int32_t version = IMAGE_VERSION;
 
+    fwrite_chk(fp, (char *) &version, sizeof(version));
     fwrite_chk(fp, (char *) &symbols, sizeof(object));
 
     for (int i = 0; i < OBJECT_TABLE_MAX; i++) {
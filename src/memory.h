@@ -52,6 +52,7 @@ extern const object nilobj;
 extern object allocObject(size_int memorySize);
 extern object allocByte(size_int size);
 extern object allocStr(char *str);
+extern object recycledFloat(void);
 extern void initMemoryManager(void);
 extern void sysDecr(object z);
 extern void byteAtPut(object z, int i, int x);
@@ -60,6 +61,7 @@ extern int freeCount(void);
 extern void imageWrite(FILE * fp);
 extern void imageRead(FILE * fp);
 extern void setStringValue(object x, const char *str); 
+extern void growObject(object x, size_int newSize);
 extern void printObjectTable(const char *filename);
 
 static inline boolean isInteger(object x);
@@ -104,6 +106,19 @@ static inline void decr(object z) {
     if (obj->referenceCount == 0) { sysDecr(z); }
 }// decr
 
+// Drop a reference to z without freeing it if that was the last one,
+// leaving it as a newly made object would be.  This hands an object
+// taken out of a container over to whoever gets it next, such as the
+// interpreter, when a primitive returns it.
+static inline void disown(object z) {
+    if (!z || isInteger(z)) { return; }
+
+    struct objectStruct *obj = &ObjectTable[oNdx(z)];
+    if (obj->referenceCount > 0 && obj->referenceCount < COUNT_MAX) {
+        obj->referenceCount--;
+    }
+}// disown
+
 
 /*
     Integer objects are (but need not be) treated specially.
@@ -188,8 +203,14 @@ static inline object basicAt(object x, int i) {
     return op->memory[i-1];
 }
 
+// The number of bytes in byte object x.  Its memory holds one more, a
+// 0 after the last, which the size field also counts; this keeps an
+// empty byte object apart from an empty pointer object and lets C
+// string functions read text directly.
+static inline int byteLength(object x) { return -sizeField(x) - 1; }
+
 static inline int byteAt(object x, int i) {
-    assert(i > 0 && i <= -sizeField(x));
+    assert(i > 0 && i <= byteLength(x));
     return (int)(bytePtr(x)[i-1]);
 }
 
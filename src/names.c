@@ -33,6 +33,7 @@
 #include "memory.h"
 #include "tty.h"
 #include "news.h"
+#include "dict.h"
 
 #include "names.h"
 
@@ -42,71 +43,44 @@ const object nilobj = NIL_OBJ;
 // These are initialized 
 object trueobj = 0;
 object falseobj = 0;
+object floatClass = 0;
 
 
+// Set key's value in the name table dict, hashing it as 'hash'.  (See
+// dict.c for the table itself.)
 void
 nameTableInsert (object dict, int hash, object key, object value) {
-    object table, link, nwLink, nextLink, tablentry;
+    object table = basicAt(dict, 1);
+    int index = 0;
 
-    /* first get the hash table */
-    table = basicAt(dict, 1);
-
-    if (sizeField(table) < 3) {
-        sysError("attempt to insert into", "too small name table");
-    } else {
-        hash = 3 * (hash % (sizeField(table) / 3));
-        tablentry = basicAt(table, hash + 1);
-        if ((tablentry == nilobj) || (tablentry == key)) {
-            basicAtPut(table, hash + 1, key);
-            basicAtPut(table, hash + 2, value);
-        } else {
-            nwLink = newLink(key, value);
-            incr(nwLink);
-            link = basicAt(table, hash + 3);
-            if (link == nilobj) {
-                basicAtPut(table, hash + 3, nwLink);
-            } else
-                while (1)
-                    if (basicAt(link, 1) == key) {
-                        basicAtPut(link, 2, value);
-                        break;
-                    } else if ((nextLink = basicAt(link, 3)) == nilobj) {
-                        basicAtPut(link, 3, nwLink);
-                        break;
-                    } else {
-                        link = nextLink;
-                    }
-            decr(nwLink);
+    while ((index = hashTableNext(table, hash, index)) != 0) {
+        if (basicAt(table, index - 1) == key) {
+            hashTableSetValue(table, index, value);
+            return;
         }
     }
+
+    if (!hashTableAdd(table, hash, key, value)) {
+        sysError("attempt to insert into", "full name table");
+    }
 }
 
+// Return the value of the first key in dict with this hash for which
+// fun(key, arg) is true, or nil.
 object
-hashEachElement (object dict, int hash, int (*fun)(object)) {
-    object table, key, value, link;
-    object *hp;
-    int tablesize;
+hashEachElement (object dict, int hash, int (*fun)(object, void *),
+                 void *arg) {
+    object table;
+    int index = 0;
 
-    table = basicAt(dict, 1);
+    if (dict == nilobj) {
+        return nilobj;
+    }
 
-    /* now see if table is valid */
-    if ((tablesize = sizeField(table)) < 3) {
-        sysError("system error", "lookup on null table");
-    } else {
-        hash = 1 + (3 * (hash % (tablesize / 3)));
-        hp = sysMemPtr(table) + (hash - 1);
-        key = *hp++;		/* table at: hash */
-        value = *hp++;		/* table at: hash + 1 */
-        if ((key != nilobj) && (*fun) (key)) {
-            return value;
-        }
-        for (link = *hp; link != nilobj; link = *hp) {
-            hp = sysMemPtr(link);
-            key = *hp++;	/* link at: 1 */
-            value = *hp++;	/* link at: 2 */
-            if ((key != nilobj) && (*fun) (key)) {
-                return value;
-            }
+    table = basicAt(dict, 1);
+    while ((index = hashTableNext(table, hash, index)) != 0) {
+        if ((*fun) (basicAt(table, index - 1), arg)) {
+            return basicAt(table, index);
         }
     }
     return nilobj;
@@ -133,15 +107,21 @@ strHash (		/* compute hash value of string ---- strHash */
     return hash;
 }
 
-static object objBuffer;
-static char *charBuffer;
+/* what strTest is looking for, and what it found */
+struct StrSearch {
+    char *str;
+    object key;
+};
 
 static int
 strTest (		/* test for string equality ---- strTest */
-    object key
+    object key,
+    void *arg
 ) {
-    if (charPtr(key) && streq(charPtr(key), charBuffer)) {
-        objBuffer = key;
+    struct StrSearch *search = arg;
+
+    if (charPtr(key) && streq(charPtr(key), search->str)) {
+        search->key = key;
         return 1;
     }
     return 0;
@@ -151,16 +131,17 @@ object
 globalKey (		/* return key associated with global symbol */
     char *str
 ) {
-    objBuffer = nilobj;
-    charBuffer = str;
-    hashEachElement(symbols, strHash(str), strTest);
-    return objBuffer;
+    struct StrSearch search = { str, nilobj };
+
+    hashEachElement(symbols, strHash(str), strTest, &search);
+    return search.key;
 }
 
 object
 globalSymbol(char *str) {
-    charBuffer = str;
-    return hashEachElement(symbols, strHash(str), strTest);
+    struct StrSearch search = { str, nilobj };
+
+    return hashEachElement(symbols, strHash(str), strTest, &search);
 }
 
 object unSyms[12];
@@ -185,6 +166,7 @@ initCommonSymbols (void) {
 
     trueobj = globalSymbol("true");
     falseobj = globalSymbol("false");
+    floatClass = globalSymbol("Float");
     for (i = 0; unStrs[i]; i++) {
         unSyms[i] = newSymbol(unStrs[i]);
     }
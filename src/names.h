@@ -38,10 +38,22 @@ enum ClassOffsets {
     OFST_block_argumentLocation = 3,
     OFST_block_bytecountPosition = 4,
 
-    OBSIZE_process = 3,
+    OBSIZE_process = 6,
     OFST_process_stack = 1,
     OFST_process_stackTop = 2,
     OFST_process_linkPtr = 3,
+    OFST_process_priority = 4,
+    OFST_process_state = 5,
+    OFST_process_ticket = 6,
+
+    OBSIZE_semaphore = 2,
+    OFST_semaphore_count = 1,
+    OFST_semaphore_waiting = 2,
+
+    OBSIZE_sharedQueue = 3,
+    OFST_sharedQueue_buffer = 1,
+    OFST_sharedQueue_readers = 2,
+    OFST_sharedQueue_writers = 3,
 };
 
 // Index of nilobj; this needs to be a #define so that we can use it
@@ -52,6 +64,7 @@ enum ClassOffsets {
 extern const object nilobj;
 extern object trueobj;        // the pseudo variable true
 extern object falseobj;       // the pseudo variable false */
+extern object floatClass;     // the class Float, once it exists
 
 // Well-known symbols; these are a (faster) special case in the
 // interpreter.
@@ -59,7 +72,8 @@ extern object unSyms[], binSyms[];
 
 extern object globalSymbol(char *str);
 extern void nameTableInsert(object dict, int hash, object key, object value);
-extern object hashEachElement(object dict, int hash, int (*fun)(object));
+extern object hashEachElement(object dict, int hash,
+                              int (*fun)(object, void *), void *arg);
 extern int strHash(char *str);
 extern object globalKey(char *str);
 extern object nameTableLookup(object dict, char *str);
@@ -12,6 +12,7 @@
 #include "memory.h"
 #include "names.h"
 #include "news.h"
+#include "dict.h"
 
 static object arrayClass = NIL_OBJ;     /* the class Array */
 static object intClass = NIL_OBJ;       /* the class Integer */
@@ -118,12 +119,10 @@ newContext (int link, object method, object args, object temp) {
 object
 newDictionary () {
     object newObj;
-    const int METHOD_TABLE_SIZE = 39;   // Duplicated in Smalltalk code.
-    
 
     newObj = allocObject(1);
     setClass(newObj, globalSymbol("Dictionary"));
-    basicAtPut(newObj, 1, newArray(METHOD_TABLE_SIZE));
+    basicAtPut(newObj, 1, newHashTable(0, FALSE));
     return newObj;
 }
 
@@ -131,9 +130,17 @@ object
 newFloat (double d) {
     object newObj;
 
-    newObj = allocByte((int) sizeof(double));
+    // Float doesn't exist yet while the initial image is being built.
+    if (floatClass == nilobj) {
+        floatClass = globalSymbol("Float");
+    }
+
+    newObj = recycledFloat();
+    if (newObj == nilobj) {
+        newObj = allocByte((int) sizeof(double));
+        setClass(newObj, floatClass);
+    }
     memcpy(charPtr(newObj), (char *) &d, (int) sizeof(double));
-    setClass(newObj, globalSymbol("Float"));
     return newObj;
 }
 
@@ -34,6 +34,15 @@
 #include "names.h"
 #include "parser.h"
 #include "interp.h"
+#include "sched.h"
+#include "worker.h"
+#include "dict.h"
+#include "deque.h"
+#include "sort.h"
+#include "bulk.h"
+#include "stream.h"
+#include "longint.h"
+#include "vector.h"
 #include "tty.h"
 #include "news.h"
 #include "unixio.h"
@@ -68,8 +77,8 @@ zeroaryPrims (int number) {
         break;
 
     case 4:			/* return time in seconds */
-        i = (short) time((long *) 0);
-        returnedObject = newInteger(i);
+        /* too big for a SmallInteger, but a double holds it exactly */
+        returnedObject = newFloat((double) time(NULL));
         break;
 
     case 5:			/* flip watch - done in interp */
@@ -86,9 +95,9 @@ zeroaryPrims (int number) {
 }
 
 static int
-unaryPrims (int number, object firstarg) {
-    int i, j, saveLinkPointer;
-    object returnedObject, saveProcessStack;
+unaryPrims (struct VM *vm, int number, object firstarg) {
+    int i, j;
+    object returnedObject;
 
     returnedObject = firstarg;
     switch (number) {
@@ -103,7 +112,7 @@ unaryPrims (int number, object firstarg) {
             i = sizeField(firstarg);
             /* byte objects have negative size */
             if (i < 0) {
-                i = (-i);
+                i = byteLength(firstarg);
             }
         }
         returnedObject = newInteger(i);
@@ -123,54 +132,20 @@ unaryPrims (int number, object firstarg) {
 
     case 8:			/* change return point - block return */
         /* first get previous link pointer */
-        i = intValue(basicAt(processStack, linkPointer));
+        i = intValue(basicAt(vm->processStack, vm->linkPointer));
         /* then creating context pointer */
         j = intValue(basicAt(firstarg, 1));
-        if (basicAt(processStack, j + 1) != firstarg) {
+        if (basicAt(vm->processStack, j + 1) != firstarg) {
             returnedObject = falseobj;
             break;
         }
         /* first change link pointer to that of creator */
-        fieldAtPut(processStack, i, basicAt(processStack, j));
+        fieldAtPut(vm->processStack, i, basicAt(vm->processStack, j));
         /* then change return point to that of creator */
-        fieldAtPut(processStack, i + 2, basicAt(processStack, j + 2));
+        fieldAtPut(vm->processStack, i + 2, basicAt(vm->processStack, j + 2));
         returnedObject = trueobj;
         break;
 
-    case 9:			/* process execute */
-        /* first save the values we are about to clobber */
-        saveProcessStack = processStack;
-        saveLinkPointer = linkPointer;
-#ifdef SIGNAL
-        /* trap control-C */
-        signal(SIGINT, brkfun);
-        if (setjmp(jb)) {
-            returnedObject = falseobj;
-        } else
-#endif
-#ifdef CRTLBRK
-            /* trap control-C using dos ctrlbrk routine */
-            ctrlbrk(brkfun);
-        if (setjmp(jb)) {
-            returnedObject = falseobj;
-        } else
-#endif
-            if (execute(firstarg, 5000)) {
-                returnedObject = trueobj;
-            } else {
-                returnedObject = falseobj;
-            }
-        /* then restore previous environment */
-        processStack = saveProcessStack;
-        linkPointer = saveLinkPointer;
-#ifdef SIGNAL
-        signal(SIGINT, brkignore);
-#endif
-#ifdef CTRLBRK
-        ctrlbrk(brkignore);
-#endif
-        break;
-
     default:			/* unknown primitive */
         sysError("unknown primitive", "unaryPrims");
         break;
@@ -179,8 +154,7 @@ unaryPrims (int number, object firstarg) {
 }
 
 static int
-binaryPrims (int number, object firstarg, object secondarg) {
-    char buffer[2000];
+binaryPrims (struct VM *vm, int number, object firstarg, object secondarg) {
     int i;
     object returnedObject;
 
@@ -205,9 +179,16 @@ binaryPrims (int number, object firstarg, object secondarg) {
         break;
 
     case 4:			/* string cat */
-        strcpy(buffer, charPtr(firstarg));
-        strcat(buffer, charPtr(secondarg));
-        returnedObject = newStString(buffer);
+        returnedObject = nilobj;
+        if (isBytes(firstarg) && isBytes(secondarg) &&
+            byteLength(firstarg) + byteLength(secondarg) < OBJSIZE_MAX) {
+            i = byteLength(firstarg);
+            returnedObject = allocByte(i + byteLength(secondarg));
+            setClass(returnedObject, globalSymbol("String"));
+            memcpy(charPtr(returnedObject), charPtr(firstarg), i);
+            memcpy(charPtr(returnedObject) + i, charPtr(secondarg),
+                   byteLength(secondarg));
+        }
         break;
 
     case 5:			/* basicAt: */
@@ -235,10 +216,10 @@ binaryPrims (int number, object firstarg, object secondarg) {
 
     case 8:			/* block start */
         /* first get previous link */
-        i = intValue(basicAt(processStack, linkPointer));
+        i = intValue(basicAt(vm->processStack, vm->linkPointer));
         /* change context and byte pointer */
-        fieldAtPut(processStack, i + 1, firstarg);
-        fieldAtPut(processStack, i + 4, secondarg);
+        fieldAtPut(vm->processStack, i + 1, firstarg);
+        fieldAtPut(vm->processStack, i + 4, secondarg);
         break;
 
     case 9:			/* duplicate a block, adding a new context to it */
@@ -258,9 +239,8 @@ binaryPrims (int number, object firstarg, object secondarg) {
 }
 
 static int
-trinaryPrims (int number, object firstarg, object secondarg, object thirdarg) {
-    char *bp, *tp, buffer[256];
-    int i, j;
+trinaryPrims (struct VM *vm, int number, object firstarg, object secondarg,
+              object thirdarg) {
     object returnedObject;
 
     returnedObject = firstarg;
@@ -285,25 +265,17 @@ trinaryPrims (int number, object firstarg, object secondarg, object thirdarg) {
         break;
 
     case 3:			/* string copyFrom:to: */
-        bp = charPtr(firstarg);
         if ((!isInteger(secondarg)) || (!isInteger(thirdarg))) {
             sysError("non integer index", "copyFromTo");
         }
-        i = intValue(secondarg);
-        j = intValue(thirdarg);
-        tp = buffer;
-        if (i <= strlen(bp))
-            for (; (i <= j) && bp[i - 1]; i++) {
-                *tp++ = bp[i - 1];
-            }
-        *tp = '\0';
-        returnedObject = newStString(buffer);
+        returnedObject = copyRange(firstarg, intValue(secondarg),
+                                   intValue(thirdarg));
         break;
 
     case 9:			/* compile method */
         setInstanceVariables(firstarg);
         if (parse(thirdarg, charPtr(secondarg), FALSE)) {
-            flushCache(basicAt(thirdarg, OFST_method_message), firstarg);
+            flushCache(vm, basicAt(thirdarg, OFST_method_message), firstarg);
             returnedObject = trueobj;
         } else {
             returnedObject = falseobj;
@@ -365,7 +337,7 @@ intBinary (int number, int firstarg, int secondarg) {
         if (longCanBeInt(longresult)) {
             firstarg = longresult;
         } else {
-            goto overflow;
+            return longIntegerFrom(longresult);
         }
         break;
     case 1:			/* subtraction */
@@ -374,7 +346,7 @@ intBinary (int number, int firstarg, int secondarg) {
         if (longCanBeInt(longresult)) {
             firstarg = longresult;
         } else {
-            goto overflow;
+            return longIntegerFrom(longresult);
         }
         break;
 
@@ -404,7 +376,7 @@ intBinary (int number, int firstarg, int secondarg) {
         if (longCanBeInt(longresult)) {
             firstarg = longresult;
         } else {
-            goto overflow;
+            return longIntegerFrom(longresult);
         }
         break;
 
@@ -432,9 +404,12 @@ intBinary (int number, int firstarg, int secondarg) {
 
     case 19:			/* shifts */
         if (secondarg < 0) {
-            firstarg >>= (-secondarg);
+            firstarg >>= (secondarg > -31 ? -secondarg : 31);
+        } else if (secondarg < 31 &&
+                   longCanBeInt(longresult = (long) firstarg * (1L << secondarg))) {
+            firstarg = longresult;
         } else {
-            firstarg <<= secondarg;
+            return longIntegerShift(newInteger(firstarg), secondarg);
         }
         break;
     }
@@ -457,12 +432,13 @@ overflow:
 }
 
 static int
-strUnary (int number, char *firstargument) {
+strUnary (int number, object firstarg) {
     object returnedObject = nilobj;
+    char *firstargument = charPtr(firstarg);
 
     switch (number) {
     case 1:			/* length of string */
-        returnedObject = newInteger(strlen(firstargument));
+        returnedObject = newInteger(byteLength(firstarg));
         break;
 
     case 2:			/* hash value of symbol */
@@ -602,12 +578,39 @@ floatBinary (int number, double first, double second) {
 	the main driver for the primitive handler
 */
 object
-primitive (int primitiveNumber, object *arguments) {
+primitive (struct VM *vm, int primitiveNumber, object *arguments) {
     int primitiveGroup = primitiveNumber / 10;
     object returnedObject = nilobj;
 
 
-    if (primitiveNumber >= 150) {
+    if (primitiveNumber >= 160 && primitiveNumber < 180) {
+        /* process scheduling, see sched.c */
+        returnedObject = schedPrimitive(primitiveNumber - 160, arguments);
+    } else if (primitiveNumber >= 180 && primitiveNumber < 190) {
+        /* worker VMs, see worker.c */
+        returnedObject = workerPrimitive(primitiveNumber - 180, arguments);
+    } else if (primitiveNumber >= 190 && primitiveNumber < 200) {
+        /* hash tables, see dict.c */
+        returnedObject = dictPrimitive(primitiveNumber - 190, arguments);
+    } else if (primitiveNumber >= 200 && primitiveNumber < 210) {
+        /* deques, see deque.c */
+        returnedObject = dequePrimitive(primitiveNumber - 200, arguments);
+    } else if (primitiveNumber >= 210 && primitiveNumber < 220) {
+        /* sorting, see sort.c */
+        returnedObject = sortPrimitive(vm, primitiveNumber - 210, arguments);
+    } else if (primitiveNumber >= 220 && primitiveNumber < 230) {
+        /* bulk copies and comparisons, see bulk.c */
+        returnedObject = bulkPrimitive(primitiveNumber - 220, arguments);
+    } else if (primitiveNumber >= 230 && primitiveNumber < 240) {
+        /* streams and number printing, see stream.c */
+        returnedObject = streamPrimitive(primitiveNumber - 230, arguments);
+    } else if (primitiveNumber >= 240 && primitiveNumber < 250) {
+        /* LongInteger arithmetic, see longint.c */
+        returnedObject = longIntegerPrimitive(primitiveNumber - 240, arguments);
+    } else if (primitiveNumber >= 250) {
+        /* FloatArray and IntegerArray, see vector.c */
+        returnedObject = vectorPrimitive(primitiveNumber - 250, arguments);
+    } else if (primitiveNumber >= 150) {
         /* system dependent primitives, handled in separate module */
         returnedObject = sysPrimitive(primitiveNumber, arguments);
     } else {
@@ -617,16 +620,16 @@ primitive (int primitiveNumber, object *arguments) {
             break;
         case 1:
             returnedObject =
-                unaryPrims(primitiveNumber - 10, arguments[0]);
+                unaryPrims(vm, primitiveNumber - 10, arguments[0]);
             break;
         case 2:
             returnedObject =
-                binaryPrims(primitiveNumber - 20, arguments[0],
+                binaryPrims(vm, primitiveNumber - 20, arguments[0],
                             arguments[1]);
             break;
         case 3:
             returnedObject =
-                trinaryPrims(primitiveNumber - 30, arguments[0],
+                trinaryPrims(vm, primitiveNumber - 30, arguments[0],
                              arguments[1], arguments[2]);
             break;
 
@@ -650,7 +653,7 @@ primitive (int primitiveNumber, object *arguments) {
 
         case 8:		/* string unary */
             returnedObject =
-                strUnary(primitiveNumber - 80, charPtr(arguments[0]));
+                strUnary(primitiveNumber - 80, arguments[0]);
             break;
 
         case 10:		/* float unary */
@@ -1,6 +1,8 @@
 #ifndef __PRIMITIVE_H
 #define __PRIMITIVE_H
 
-object primitive(int primitiveNumber, object *arguments);
+struct VM;
+
+object primitive(struct VM *vm, int primitiveNumber, object *arguments);
 
 #endif
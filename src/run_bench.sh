@@ -0,0 +1,33 @@
+#!/bin/bash
+
+# Helper script to time the benchmarks in optional/bench.st on the
+# newly-built VM, with and without the translation tier (jit.c).  Each
+# benchmark is run several times and the best user time is reported,
+# since the slower runs mostly measure whatever else the machine was
+# doing.
+
+set -e
+
+cd ../optional
+
+runs=${RUNS:-5}
+TIMEFORMAT=%U
+
+best () {
+    local best=
+    for run in `seq $runs`; do
+        t=`{ time ../lst3 ../systemImage "$@" > /dev/null 2>&1; } 2>&1`
+        if [ -z "$best" ] || awk "BEGIN { exit !($t < $best) }"; then
+            best=$t
+        fi
+    done
+    echo $best
+}
+
+printf "%-10s %10s %10s\n" benchmark translated -Xnojit
+for bench in loops sends blocks; do
+    script="File new; fileIn: 'bench.st'. Bench new $bench"
+    printf "%-10s %10s %10s\n" $bench \
+        `best -e "$script" < /dev/null` \
+        `best -Xnojit -e "$script" < /dev/null`
+done
@@ -3,12 +3,18 @@
 # Helper script to run tests on the newly-built VM.  lst can't exit
 # with a different status, so we need to trawl through the output
 # looking for error messages.
+#
+# The suite is run twice, with and without the translation tier
+# (jit.c), and again with timed slices (sched.c); the runs must all
+# produce identical output.
 
 set -e
 
 cd ../optional
 
-results=`mktemp -t lst.testresults`
+results=`mktemp -t lst.testresults.XXXXXX`
+nojit_results=`mktemp -t lst.testresults.XXXXXX`
+timed_results=`mktemp -t lst.testresults.XXXXXX`
 
 echo
 echo "Running tests:"
@@ -17,13 +23,33 @@ echo "Running tests:"
     tee $results
 echo
 
-if grep -q failure $results; then
+echo "Running tests without translation:"
+../lst3 ../systemImage -Xnojit \
+        -e "File new; fileIn: 'test.st'. Test new allAndQuit" \
+    > $nojit_results
+echo
+
+echo "Running tests with timed slices:"
+../lst3 ../systemImage -Xslice 1000 \
+        -e "File new; fileIn: 'test.st'. Test new allAndQuit" \
+    > $timed_results
+echo
+
+status=0
+if grep -q failure $results $nojit_results $timed_results; then
     echo "Test failed!"
-    rm $results
-    exit 1
+    status=1
+elif ! cmp -s $results $nojit_results; then
+    echo "Translated and untranslated runs differ:"
+    diff $nojit_results $results || true
+    status=1
+elif ! cmp -s $timed_results $results; then
+    echo "Timed and counted slices differ:"
+    diff $results $timed_results || true
+    status=1
 else
     echo "All tests passed!"
-    rm $results
-    exit 0
 fi
 
+rm -f $results $nojit_results $timed_results
+exit $status
@@ -0,0 +1,988 @@
+/*
+    The native process scheduler.
+
+    Ready processes are kept in one FIFO queue per priority; the
+    scheduler always runs the first process of the highest non-empty
+    queue for a time slice and then puts it back at the end of its
+    queue.  The system process (which runs the read-eval-print loop in
+    Scheduler>>run) is not queued: it runs only when no other process
+    is ready.
+
+    Each Process carries its priority, its state and a "ticket".  Every
+    time a process is queued, its ticket is bumped and the queue entry
+    records the new value.  An entry whose ticket no longer matches (or
+    whose process is no longer ready) is stale and is simply dropped
+    when it reaches the front of the queue.  This makes resuming,
+    suspending and terminating a process O(1) no matter how many
+    processes there are.
+
+    The ready queues live only in C, so processes that are merely
+    ready are not resumed when a saved image is restarted; the system
+    process is always started afresh.
+
+    Semaphores, on the other hand, keep their waiting processes in a
+    "ring", an Array used as a circular FIFO (see below), so that they
+    can be saved with the image.  A waiting process is never made ready
+    by anything but a signal (or killed by terminate), so a ring entry
+    is valid as long as its process is still waiting.
+
+    Time slices are normally counted in bytecodes.  Alternatively (see
+    schedSetSliceTime()), each slice gets an interval timer and the
+    interpreter gives up the processor at the next send or backward
+    branch after it goes off.
+
+    Sleeping processes (see Delay in mult.st) are kept in a
+    hierarchical timer wheel, so a sleeper costs nothing until it is
+    due.  Reading from stdin (or from a worker, see worker.c) also lets
+    the other processes run until there is input.  When nothing at all
+    is ready, the VM blocks in a single poll() until the next sleeper
+    is due or input arrives.
+
+    Blocks that primitives call back into (see blockCallStart() in
+    interp.c) make the current process atomic for a while: nothing
+    preempts it, a sleep stops the whole VM and a wait that nothing
+    could ever end kills the process instead.
+*/
+
+#define _XOPEN_SOURCE 600       // for setitimer(), poll(), etc.
+
+#include <stdio.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include "common.h"
+#include "memory.h"
+#include "names.h"
+#include "interp.h"
+#include "news.h"
+
+#include "sched.h"
+
+// A growable FIFO of (process, ticket) pairs.  Entries hold a
+// reference to their process.
+struct ProcQueue {
+    struct ProcEntry {
+        object process;
+        int ticket;
+    } *entries;
+    int head, count, capacity;
+};
+
+static struct ProcQueue readyQueues[SCHED_PRIORITIES];
+
+static struct VM *vm = NULL;          // the interpreter that runs them
+static object systemProcess = NIL_OBJ;
+static object currentProcess = NIL_OBJ;
+
+static int atomicDepth = 0;           // see schedBeginAtomic()
+static boolean switchDeferred = FALSE;  // preempted while atomic
+
+boolean schedSwitchPending = FALSE;
+
+volatile sig_atomic_t schedTimerExpired = 0;
+static long sliceMicros = 0;        // 0 means count bytecodes instead
+
+
+/*
+    Process fields.
+*/
+
+static int
+stateOf(object process) {
+    object state = basicAt(process, OFST_process_state);
+    return state == nilobj ? PS_Suspended : intValue(state);
+}// stateOf
+
+static void
+setState(object process, int state) {
+    fieldAtPut(process, OFST_process_state, newInteger(state));
+}// setState
+
+static int
+ticketOf(object process) {
+    object ticket = basicAt(process, OFST_process_ticket);
+    return ticket == nilobj ? 0 : intValue(ticket);
+}// ticketOf
+
+// Invalidate all existing queue entries for process and return its
+// new ticket.
+static int
+newTicket(object process) {
+    int ticket = (ticketOf(process) + 1) % OBJINT_MAX;
+    fieldAtPut(process, OFST_process_ticket, newInteger(ticket));
+    return ticket;
+}// newTicket
+
+// Return the priority of process as an index into readyQueues.
+static int
+priorityOf(object process) {
+    object pri = basicAt(process, OFST_process_priority);
+    int priority = isInteger(pri) ? intValue(pri) : SCHED_DEFAULT_PRIORITY;
+
+    if (priority < 1) { priority = 1; }
+    if (priority > SCHED_PRIORITIES) { priority = SCHED_PRIORITIES; }
+
+    return priority - 1;
+}// priorityOf
+
+
+
+/*
+    Queues.
+*/
+
+static void
+enqueue(struct ProcQueue *q, object process, int ticket) {
+    if (q->count == q->capacity) {
+        int newCapacity = q->capacity ? q->capacity * 2 : 16;
+        struct ProcEntry *entries =
+            ck_calloc(newCapacity, sizeof(struct ProcEntry));
+
+        for (int n = 0; n < q->count; n++) {
+            entries[n] = q->entries[(q->head + n) % q->capacity];
+        }
+        free(q->entries);
+
+        q->entries = entries;
+        q->head = 0;
+        q->capacity = newCapacity;
+    }
+
+    struct ProcEntry *e = &q->entries[(q->head + q->count) % q->capacity];
+    e->process = process;
+    e->ticket = ticket;
+    incr(process);
+    q->count++;
+}// enqueue
+
+// Remove and return the first entry of q that is still valid (i.e.
+// its process is in the given state and it has the current ticket) or
+// nilobj if there is none.  The caller gets the queue's reference.
+static object
+dequeue(struct ProcQueue *q, int state) {
+    while (q->count > 0) {
+        struct ProcEntry e = q->entries[q->head];
+
+        q->head = (q->head + 1) % q->capacity;
+        q->count--;
+
+        if (stateOf(e.process) == state && ticketOf(e.process) == e.ticket) {
+            return e.process;
+        }
+        decr(e.process);
+    }
+
+    return nilobj;
+}// dequeue
+
+
+
+/*
+    Rings.
+
+    A ring is an Array whose first field holds the index of its first
+    item, whose second field holds the number of items and whose
+    remaining fields hold the items themselves.  Rings are created
+    lazily and grow as needed, so they are stored in a field of some
+    owning object rather than passed around directly.
+
+    An item that is taken out of a ring stays in its slot (and so stays
+    alive) until the slot is reused; this lets a primitive return it
+    without juggling reference counts.
+*/
+
+#define RING_HEAD   1
+#define RING_COUNT  2
+#define RING_ITEMS  2           // offset of the first item slot
+
+static int
+ringCount(object ring) {
+    return ring == nilobj ? 0 : intValue(basicAt(ring, RING_COUNT));
+}// ringCount
+
+static int
+ringCapacity(object ring) {
+    return ring == nilobj ? 0 : sizeField(ring) - RING_ITEMS;
+}// ringCapacity
+
+static object
+newRing(int capacity) {
+    object ring = newArray(capacity + RING_ITEMS);
+
+    basicAtPut(ring, RING_HEAD, newInteger(0));
+    basicAtPut(ring, RING_COUNT, newInteger(0));
+    return ring;
+}// newRing
+
+// Append item to the ring in field 'index' of owner, growing it if
+// necessary.
+static void
+ringPut(object owner, int index, object item) {
+    object ring = basicAt(owner, index);
+    int head, count, capacity;
+
+    if (ringCount(ring) == ringCapacity(ring)) {
+        object bigger = newRing(ring == nilobj ? 4 : ringCapacity(ring) * 2);
+
+        count = ringCount(ring);
+        capacity = ringCapacity(ring);
+        head = count ? intValue(basicAt(ring, RING_HEAD)) : 0;
+        for (int n = 0; n < count; n++) {
+            basicAtPut(bigger, RING_ITEMS + 1 + n,
+                       basicAt(ring, RING_ITEMS + 1 + (head + n) % capacity));
+        }
+        basicAtPut(bigger, RING_COUNT, newInteger(count));
+
+        fieldAtPut(owner, index, bigger);
+        ring = bigger;
+    }
+
+    head = intValue(basicAt(ring, RING_HEAD));
+    count = ringCount(ring);
+    capacity = ringCapacity(ring);
+
+    fieldAtPut(ring, RING_ITEMS + 1 + (head + count) % capacity, item);
+    basicAtPut(ring, RING_COUNT, newInteger(count + 1));
+}// ringPut
+
+// Remove and return the first item of ring.
+static object
+ringTake(object ring) {
+    int head = intValue(basicAt(ring, RING_HEAD));
+    object item = basicAt(ring, RING_ITEMS + 1 + head);
+
+    basicAtPut(ring, RING_HEAD, newInteger((head + 1) % ringCapacity(ring)));
+    basicAtPut(ring, RING_COUNT, newInteger(ringCount(ring) - 1));
+    return item;
+}// ringTake
+
+
+
+/*
+    Scheduling.
+*/
+
+// Make process ready to run.  Does nothing unless it is suspended or
+// waiting.
+static void
+makeReady(object process) {
+    int state = stateOf(process);
+
+    if (state != PS_Suspended && state != PS_Waiting) { return; }
+
+    // The system process is never queued; it just becomes runnable.
+    if (process == systemProcess) {
+        setState(process, PS_Suspended);
+        newTicket(process);
+        return;
+    }
+
+    setState(process, PS_Ready);
+    enqueue(&readyQueues[priorityOf(process)], process, newTicket(process));
+
+    // Preempt the current process if this one is more important.
+    if (currentProcess == systemProcess ||
+        (currentProcess != nilobj &&
+         priorityOf(process) > priorityOf(currentProcess))) {
+        if (atomicDepth > 0) {
+            switchDeferred = TRUE;
+        } else {
+            schedSwitchPending = TRUE;
+        }
+    }
+}// makeReady
+
+// Take process out of the running (and put it in the given state).
+static void
+stop(object process, int state) {
+    if (stateOf(process) == PS_Terminated) { return; }
+
+    // An atomic process would never be woken.
+    if (process == currentProcess && atomicDepth > 0 &&
+            state != PS_Terminated) {
+        sysWarn("process would wait while atomic", "terminating it");
+        state = PS_Terminated;
+    }
+
+    setState(process, state);
+    newTicket(process);
+
+    if (process == currentProcess) {
+        schedSwitchPending = TRUE;
+    }
+}// stop
+
+
+/*
+    Timed slices.
+*/
+
+static void
+timerExpired(int sig) {
+    schedTimerExpired = 1;
+}// timerExpired
+
+// Start (or, if micros is 0, stop) the slice timer.
+static void
+setTimer(long micros) {
+    struct itimerval t = {
+        .it_value = { .tv_sec = micros / 1000000,
+                      .tv_usec = micros % 1000000 },
+    };
+    setitimer(ITIMER_REAL, &t, NULL);
+}// setTimer
+
+// Make each time slice last 'micros' microseconds of real time
+// instead of SCHED_TIME_SLICE bytecodes.
+void
+schedSetSliceTime(long micros) {
+    struct sigaction sa;
+
+    if (micros <= 0) { return; }
+
+    sa.sa_handler = timerExpired;
+    sa.sa_flags = SA_RESTART;       // don't interrupt reading input
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGALRM, &sa, NULL);
+
+    sliceMicros = micros;
+}// schedSetSliceTime
+
+
+/*
+    Sleeping.
+
+    The timer wheel has WHEEL_LEVELS levels of WHEEL_SLOTS slots each.
+    A slot on level 0 covers one millisecond; a slot on each level
+    above covers a whole turn of the level below.  A timer goes on the
+    lowest level whose span covers it; as time passes, the slots of the
+    higher levels are cascaded down, so that expiring timers only ever
+    looks at one level-0 slot per millisecond.  Timers too far in the
+    future to fit just sit in the top level until they are cascaded.
+*/
+
+#define WHEEL_BITS      6
+#define WHEEL_SLOTS     (1 << WHEEL_BITS)
+#define WHEEL_LEVELS    4
+#define WHEEL_SPAN(lvl) (1LL << (WHEEL_BITS * (lvl)))
+
+struct Timer {
+    struct Timer *next;
+    object process;
+    int ticket;
+    long long due;          // in milliseconds (see clockMillis())
+};
+
+static struct Timer *wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+static long long wheelTime = 0;     // the wheel has been run up to here
+static int timerCount = 0;
+
+static long long
+clockMillis(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}// clockMillis
+
+static void
+wheelInsert(struct Timer *t) {
+    long long when = t->due;
+    int level, slot;
+
+    for (level = 0; level < WHEEL_LEVELS - 1; level++) {
+        if (when - wheelTime < WHEEL_SPAN(level + 1)) { break; }
+    }
+    if (when - wheelTime >= WHEEL_SPAN(WHEEL_LEVELS)) {
+        when = wheelTime + WHEEL_SPAN(WHEEL_LEVELS) - 1;
+    }
+
+    slot = (when >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1);
+    t->next = wheel[level][slot];
+    wheel[level][slot] = t;
+}// wheelInsert
+
+// Wake t's process (if it is still asleep) and free t.
+static void
+expire(struct Timer *t) {
+    if (stateOf(t->process) == PS_Waiting &&
+        ticketOf(t->process) == t->ticket) {
+        makeReady(t->process);
+    }
+    decr(t->process);
+    free(t);
+    timerCount--;
+}// expire
+
+// Run the wheel up to the current time, waking every process that is
+// due.
+static void
+wakeSleepers(void) {
+    long long now = clockMillis();
+
+    if (timerCount == 0) {
+        wheelTime = now;
+        return;
+    }
+
+    while (wheelTime < now) {
+        struct Timer *t, *next;
+        int level;
+
+        wheelTime++;
+
+        // Cascade every level whose current slot just came around,
+        // highest first.
+        for (level = 1; level < WHEEL_LEVELS; level++) {
+            if (wheelTime & (WHEEL_SPAN(level) - 1)) { break; }
+        }
+        while (--level > 0) {
+            int slot = (wheelTime >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1);
+
+            t = wheel[level][slot];
+            wheel[level][slot] = NULL;
+            for (; t; t = next) {
+                next = t->next;
+                wheelInsert(t);
+            }
+        }
+
+        t = wheel[0][wheelTime & (WHEEL_SLOTS - 1)];
+        wheel[0][wheelTime & (WHEEL_SLOTS - 1)] = NULL;
+        for (; t; t = next) {
+            next = t->next;
+            if (t->due <= wheelTime) {
+                expire(t);
+            } else {
+                wheelInsert(t);
+            }
+        }
+    }
+}// wakeSleepers
+
+// Put the current process to sleep for ms milliseconds.
+static void
+sleepFor(long long ms) {
+    struct Timer *t;
+
+    if (currentProcess == nilobj || ms <= 0) { return; }
+
+    if (atomicDepth > 0) {
+        poll(NULL, 0, ms > INT_MAX ? INT_MAX : ms);
+        return;
+    }
+
+    wakeSleepers();
+    stop(currentProcess, PS_Waiting);
+
+    t = ck_calloc(1, sizeof(struct Timer));
+    t->process = currentProcess;
+    t->ticket = ticketOf(currentProcess);
+    t->due = wheelTime + ms;
+    incr(t->process);
+
+    wheelInsert(t);
+    timerCount++;
+}// sleepFor
+
+// Return the number of milliseconds until the next sleeper is due
+// (or -1 if there are none).
+static int
+nextTimeout(void) {
+    long long first = -1;
+
+    for (int level = 0; level < WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < WHEEL_SLOTS; slot++) {
+            for (struct Timer *t = wheel[level][slot]; t; t = t->next) {
+                if (first < 0 || t->due < first) { first = t->due; }
+            }
+        }
+    }
+
+    if (first < 0) { return -1; }
+    first -= clockMillis();
+    return first < 0 ? 0 : first > INT_MAX ? INT_MAX : (int) first;
+}// nextTimeout
+
+
+
+/*
+    Waiting for input.
+*/
+
+// Processes blocked until a file descriptor is readable.  Entries are
+// validated by ticket, like those in the ready queues.
+static struct FdWaiter {
+    object process;
+    int ticket;
+    int fd;
+} *fdWaiters = NULL;
+static int fdWaiterCount = 0, fdWaiterCapacity = 0;
+
+// Wait up to timeout milliseconds (forever if it is -1) until one of
+// the descriptors being waited on is readable, and wake the processes
+// waiting on those that are.
+static void
+pollInput(int timeout) {
+    struct pollfd *pfds;
+    int ready, kept;
+
+    if (fdWaiterCount == 0) {
+        if (timeout != 0) { poll(NULL, 0, timeout); }
+        return;
+    }
+
+    pfds = ck_calloc(fdWaiterCount, sizeof(struct pollfd));
+    for (int n = 0; n < fdWaiterCount; n++) {
+        pfds[n].fd = fdWaiters[n].fd;
+        pfds[n].events = POLLIN;
+    }
+
+    // Anything but a timeout (or a signal) means a read won't block.
+    ready = poll(pfds, fdWaiterCount, timeout);
+
+    kept = 0;
+    for (int n = 0; n < fdWaiterCount; n++) {
+        struct FdWaiter w = fdWaiters[n];
+        boolean valid = stateOf(w.process) == PS_Waiting &&
+            ticketOf(w.process) == w.ticket;
+
+        if (valid && (ready <= 0 || pfds[n].revents == 0)) {
+            fdWaiters[kept++] = w;
+            continue;
+        }
+
+        if (valid) { makeReady(w.process); }
+        decr(w.process);
+    }
+    fdWaiterCount = kept;
+
+    free(pfds);
+}// pollInput
+
+// Block the current process until fd is readable.  (If fd belongs to
+// a stdio stream, the stream must be unbuffered, since stdio may
+// already have read what it is waiting for.)  Returns FALSE if it
+// blocked, in which case the caller should check again once it is
+// woken.
+boolean
+schedWaitForFd(int fd) {
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+    if (currentProcess == nilobj || atomicDepth > 0 ||
+            poll(&pfd, 1, 0) != 0) {
+        return TRUE;
+    }
+
+    if (fdWaiterCount == fdWaiterCapacity) {
+        fdWaiterCapacity = fdWaiterCapacity ? fdWaiterCapacity * 2 : 8;
+        fdWaiters = ck_realloc(fdWaiters,
+                               fdWaiterCapacity * sizeof(struct FdWaiter));
+    }
+
+    stop(currentProcess, PS_Waiting);
+    fdWaiters[fdWaiterCount++] = (struct FdWaiter) {
+        currentProcess, ticketOf(currentProcess), fd
+    };
+    incr(currentProcess);
+    return FALSE;
+}// schedWaitForFd
+
+
+
+void
+schedInit(struct VM *aVM, object aSystemProcess) {
+    vm = aVM;
+    systemProcess = aSystemProcess;
+    incr(systemProcess);
+}// schedInit
+
+
+// Forget every process but the current one, which becomes the system
+// process (so the VM ends when it does).  This is for worker VMs (see
+// worker.c), which start out as a copy of their parent.
+void
+schedIsolate(void) {
+    for (int pri = 0; pri < SCHED_PRIORITIES; pri++) {
+        struct ProcQueue *q = &readyQueues[pri];
+
+        for (; q->count > 0; q->count--) {
+            decr(q->entries[q->head].process);
+            q->head = (q->head + 1) % q->capacity;
+        }
+    }
+
+    for (int n = 0; n < fdWaiterCount; n++) {
+        decr(fdWaiters[n].process);
+    }
+    fdWaiterCount = 0;
+
+    for (int level = 0; level < WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < WHEEL_SLOTS; slot++) {
+            while (wheel[level][slot]) {
+                struct Timer *t = wheel[level][slot];
+                wheel[level][slot] = t->next;
+                decr(t->process);
+                free(t);
+            }
+        }
+    }
+    timerCount = 0;
+
+    incr(currentProcess);
+    decr(systemProcess);
+    systemProcess = currentProcess;
+}// schedIsolate
+
+
+// Make the current process atomic until the matching schedEndAtomic():
+// it isn't preempted, and it can't give up the processor other than
+// by being terminated (see above).  Calls may be nested.  linkPointer
+// is where the process has got to; it is saved in the process, whose
+// own copy is otherwise only brought up to date at the end of a slice,
+// so that Process>>trace doesn't walk a stale chain in the meantime.
+void
+schedBeginAtomic(int linkPointer) {
+    if (atomicDepth++ == 0 && currentProcess != nilobj) {
+        fieldAtPut(currentProcess, OFST_process_linkPtr,
+                   newInteger(linkPointer));
+    }
+}// schedBeginAtomic
+
+void
+schedEndAtomic(void) {
+    if (--atomicDepth == 0 && switchDeferred) {
+        switchDeferred = FALSE;
+        schedSwitchPending = TRUE;
+    }
+}// schedEndAtomic
+
+// Terminate the current process, which has got itself stuck.
+void
+schedKillCurrent(char *why) {
+    sysWarn(why, "terminating the process");
+    if (currentProcess != nilobj) {
+        stop(currentProcess, PS_Terminated);
+    }
+}// schedKillCurrent
+
+
+// Run the next process for one time slice.  Returns FALSE once the
+// system process has finished.
+boolean
+schedRunSlice(void) {
+    object process = nilobj;
+    boolean alive;
+
+    wakeSleepers();
+    pollInput(0);
+
+    for (;;) {
+        for (int pri = SCHED_PRIORITIES - 1; pri >= 0; pri--) {
+            process = dequeue(&readyQueues[pri], PS_Ready);
+            if (process != nilobj) { break; }
+        }
+        if (process != nilobj) { break; }
+
+        if (stateOf(systemProcess) == PS_Terminated) {
+            return FALSE;
+        }
+        if (stateOf(systemProcess) == PS_Suspended) {
+            process = systemProcess;
+            incr(process);
+            break;
+        }
+
+        // Nothing is ready; wait for something to happen.
+        if (timerCount == 0 && fdWaiterCount == 0) {
+            sysWarn("no runnable processes", "all processes are blocked");
+            return FALSE;
+        }
+        pollInput(nextTimeout());
+        wakeSleepers();
+    }
+
+    // A runaway process is (probably) stuck in a recursive loop.
+    if (sizeField(basicAt(process, OFST_process_stack)) > 1500) {
+        sysWarn("process stack overflow, probable loop", "");
+        setState(process, PS_Terminated);
+        alive = (process != systemProcess);
+        decr(process);
+        return alive;
+    }
+
+    currentProcess = process;
+    setState(process, PS_Running);
+    schedSwitchPending = FALSE;
+
+    if (sliceMicros) {
+        schedTimerExpired = 0;
+        setTimer(sliceMicros);
+        alive = execute(vm, process, INT_MAX);
+        setTimer(0);
+    } else {
+        alive = execute(vm, process, SCHED_TIME_SLICE);
+    }
+
+    currentProcess = nilobj;
+    if (!alive) {
+        setState(process, PS_Terminated);
+        newTicket(process);
+        decr(process);
+        return process != systemProcess;
+    }
+
+    // Round-robin within the priority, unless it stopped itself.
+    if (stateOf(process) == PS_Running) {
+        if (process == systemProcess) {
+            setState(process, PS_Suspended);
+        } else {
+            setState(process, PS_Ready);
+            enqueue(&readyQueues[priorityOf(process)], process,
+                    newTicket(process));
+        }
+    }
+
+    decr(process);
+    return TRUE;
+}// schedRunSlice
+
+
+
+/*
+    Blocking.
+
+    A process that has to wait for something puts itself on a ring in
+    the object it is waiting on and stops; whoever makes the wait
+    worthwhile takes it off again and makes it ready.
+*/
+
+// Block the current process on the ring in field 'index' of owner.
+// Returns FALSE (and does nothing) if there is no current process.
+static boolean
+block(object owner, int index) {
+    if (currentProcess == nilobj) { return FALSE; }
+
+    ringPut(owner, index, currentProcess);
+    stop(currentProcess, PS_Waiting);
+    return TRUE;
+}// block
+
+// Make the first process on ring that is still waiting ready.  Returns
+// FALSE if there was none.
+static boolean
+wake(object ring) {
+    while (ringCount(ring) > 0) {
+        object process = ringTake(ring);
+
+        if (stateOf(process) == PS_Waiting) {
+            makeReady(process);
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}// wake
+
+
+
+/*
+    Semaphores.
+*/
+
+static void
+semaphoreWait(object semaphore) {
+    object count = basicAt(semaphore, OFST_semaphore_count);
+
+    if (isInteger(count) && intValue(count) > 0) {
+        fieldAtPut(semaphore, OFST_semaphore_count,
+                   newInteger(intValue(count) - 1));
+        return;
+    }
+
+    block(semaphore, OFST_semaphore_waiting);
+}// semaphoreWait
+
+static void
+semaphoreSignal(object semaphore) {
+    object count;
+
+    if (wake(basicAt(semaphore, OFST_semaphore_waiting))) { return; }
+
+    count = basicAt(semaphore, OFST_semaphore_count);
+    fieldAtPut(semaphore, OFST_semaphore_count,
+               newInteger(isInteger(count) ? intValue(count) + 1 : 1));
+}// semaphoreSignal
+
+
+
+/*
+    Shared queues.
+
+    A SharedQueue's items live in a fixed-size ring.  Readers block
+    while it is empty and writers while it is full.  Each item moved
+    wakes at most one process waiting on the other side; the woken
+    process simply tries again, so the Smalltalk side loops until its
+    primitive succeeds.  The batch operations move as many items as
+    they can and return the new position so the loop can carry on.
+*/
+
+// Move items out of queue into array, starting after index 'done'.
+// Blocks if the queue is empty.  Returns the number of items now in
+// the array.
+static int
+queueTake(object queue, object array, int done) {
+    object buffer = basicAt(queue, OFST_sharedQueue_buffer);
+    int want = sizeField(array);
+    int moved = 0;
+
+    while (done + moved < want && ringCount(buffer) > 0) {
+        fieldAtPut(array, done + moved + 1, ringTake(buffer));
+        moved++;
+    }
+
+    if (moved == 0 && done < want) {
+        block(queue, OFST_sharedQueue_readers);
+    }
+
+    for (int n = 0; n < moved; n++) {
+        if (!wake(basicAt(queue, OFST_sharedQueue_writers))) { break; }
+    }
+
+    return done + moved;
+}// queueTake
+
+// Move the items of array after index 'done' into queue, as many as
+// will fit.  Blocks if the queue is full.  Returns the number of items
+// of array that have now been added.
+static int
+queuePut(object queue, object array, int done) {
+    object buffer = basicAt(queue, OFST_sharedQueue_buffer);
+    int size = sizeField(array);
+    int moved = 0;
+
+    while (done + moved < size &&
+           ringCount(buffer) < ringCapacity(buffer)) {
+        ringPut(queue, OFST_sharedQueue_buffer,
+                basicAt(array, done + moved + 1));
+        moved++;
+    }
+
+    if (moved == 0 && done < size) {
+        block(queue, OFST_sharedQueue_writers);
+    }
+
+    for (int n = 0; n < moved; n++) {
+        if (!wake(basicAt(queue, OFST_sharedQueue_readers))) { break; }
+    }
+
+    return done + moved;
+}// queuePut
+
+
+
+// Primitives 160-179.
+object
+schedPrimitive(int number, object *arguments) {
+    object returnedObject = nilobj;
+    object buffer;
+
+    switch (number) {
+    case 0:         /* resume a process */
+        if (stateOf(arguments[0]) == PS_Suspended) {
+            makeReady(arguments[0]);
+        }
+        break;
+
+    case 1:         /* terminate a process */
+        stop(arguments[0], PS_Terminated);
+        break;
+
+    case 2:         /* suspend a process */
+        if (stateOf(arguments[0]) != PS_Waiting) {
+            stop(arguments[0], PS_Suspended);
+        }
+        break;
+
+    case 3:         /* the current process */
+        returnedObject = currentProcess;
+        break;
+
+    case 4:         /* wait on a semaphore */
+        semaphoreWait(arguments[0]);
+        break;
+
+    case 5:         /* signal a semaphore */
+        semaphoreSignal(arguments[0]);
+        break;
+
+    case 6:         /* create a shared queue's buffer */
+        if (isInteger(arguments[1]) && intValue(arguments[1]) > 0) {
+            fieldAtPut(arguments[0], OFST_sharedQueue_buffer,
+                       newRing(intValue(arguments[1])));
+            returnedObject = arguments[0];
+        }
+        break;
+
+    case 7:         /* number of items in a shared queue */
+        returnedObject = newInteger(
+            ringCount(basicAt(arguments[0], OFST_sharedQueue_buffer)));
+        break;
+
+    case 8:         /* take an item from a shared queue */
+        buffer = basicAt(arguments[0], OFST_sharedQueue_buffer);
+        if (ringCount(buffer) > 0) {
+            returnedObject = ringTake(buffer);
+            wake(basicAt(arguments[0], OFST_sharedQueue_writers));
+        } else {
+            block(arguments[0], OFST_sharedQueue_readers);
+            returnedObject = arguments[0];      /* try again */
+        }
+        break;
+
+    case 9:         /* add an item to a shared queue */
+        buffer = basicAt(arguments[0], OFST_sharedQueue_buffer);
+        if (ringCount(buffer) < ringCapacity(buffer)) {
+            ringPut(arguments[0], OFST_sharedQueue_buffer, arguments[1]);
+            wake(basicAt(arguments[0], OFST_sharedQueue_readers));
+            returnedObject = trueobj;
+        } else {
+            block(arguments[0], OFST_sharedQueue_writers);
+            returnedObject = falseobj;          /* try again */
+        }
+        break;
+
+    case 10:        /* take items from a shared queue */
+        if (isInteger(arguments[2])) {
+            returnedObject = newInteger(
+                queueTake(arguments[0], arguments[1], intValue(arguments[2])));
+        }
+        break;
+
+    case 11:        /* add items to a shared queue */
+        if (isInteger(arguments[2])) {
+            returnedObject = newInteger(
+                queuePut(arguments[0], arguments[1], intValue(arguments[2])));
+        }
+        break;
+
+    case 12:        /* sleep for some milliseconds */
+        if (isInteger(arguments[0])) {
+            sleepFor(intValue(arguments[0]));
+            returnedObject = arguments[0];
+        } else if (arguments[0] != nilobj &&
+                   classField(arguments[0]) == floatClass) {
+            sleepFor((long long) floatValue(arguments[0]));
+            returnedObject = arguments[0];
+        }
+        break;
+
+    default:
+        sysError("unknown primitive", "schedPrimitive");
+        break;
+    }
+
+    return returnedObject;
+}// schedPrimitive
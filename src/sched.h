@@ -0,0 +1,41 @@
+/*
+    The native process scheduler.
+*/
+
+#ifndef __SCHED_H
+#define __SCHED_H
+
+#include <signal.h>
+
+struct VM;
+
+// Process states, as kept in a Process's 'state' field.  (nil counts
+// as PS_Suspended, which is where new processes start.)
+enum ProcessStates {
+    PS_Suspended = 0,       // not scheduled; resume makes it ready
+    PS_Ready = 1,           // in a ready queue
+    PS_Running = 2,         // the current process
+    PS_Waiting = 3,         // blocked (e.g. on a semaphore)
+    PS_Terminated = 4,      // finished or killed
+};
+
+// Set when the current process must give up the processor at once
+// (it blocked, was terminated or a higher-priority process became
+// ready).  The interpreter checks this after each primitive.
+extern boolean schedSwitchPending;
+
+// Set by the slice timer, if there is one; the interpreter ends the
+// slice at the next send or backward branch.
+extern volatile sig_atomic_t schedTimerExpired;
+
+extern void schedSetSliceTime(long micros);
+extern void schedInit(struct VM *vm, object systemProcess);
+extern boolean schedRunSlice(void);
+extern object schedPrimitive(int number, object *arguments);
+extern boolean schedWaitForFd(int fd);
+extern void schedIsolate(void);
+extern void schedBeginAtomic(int linkPointer);
+extern void schedEndAtomic(void);
+extern void schedKillCurrent(char *why);
+
+#endif
@@ -0,0 +1,337 @@
+/*
+    Sorting, for Array>>sort and friends.
+
+    Primitives 210-219 return a sorted copy of an Array, using a stable
+    merge sort: short runs are put in order by insertion and then merged
+    pairwise.  When the items are all numbers (SmallIntegers and
+    Floats), all Strings or all Symbols and no sort block is given,
+    they are compared here without any sends.  Otherwise each
+    comparison calls the sort block, run to completion by blockCall()
+    (see interp.c) rather than by a send from Smalltalk.  The block is
+    checked before anything is compared, so if it is left to Smalltalk
+    after all, it hasn't run yet.
+
+    Primitive 211 merges Arrays that are already sorted, so that
+    Array>>parallelSort: can sort chunks in worker VMs and merge them
+    here.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "memory.h"
+#include "names.h"
+#include "news.h"
+#include "interp.h"
+#include "tty.h"
+
+#include "bulk.h"
+#include "sort.h"
+
+enum {
+    RUN_LENGTH = 16,            // runs first sorted by insertion
+};
+
+// How the items are compared.
+enum SortKind {
+    SORT_INTEGERS,              // all SmallIntegers
+    SORT_NUMBERS,               // SmallIntegers and Floats
+    SORT_BYTES,                 // all Strings or all Symbols
+    SORT_BLOCK,                 // by calling the sort block
+};
+
+struct Sorter {
+    struct VM *vm;
+    enum SortKind kind;
+    struct BlockCall call;      // the sort block, if kind is SORT_BLOCK
+    boolean failed;             // the block couldn't be called
+};
+
+
+static object stringClass = 0, symbolClass = 0;
+
+static void
+findClasses(void) {
+    if (stringClass == nilobj) {
+        stringClass = globalSymbol("String");
+        symbolClass = globalSymbol("Symbol");
+    }
+}// findClasses
+
+// Return the kind of native comparison that suits all count items, or
+// SORT_BLOCK if there isn't one.
+static enum SortKind
+nativeKind(object *items, int count) {
+    boolean integers = TRUE, numbers = TRUE;
+    object byteClass;
+
+    findClasses();
+    for (int n = 0; n < count && numbers; n++) {
+        if (!isInteger(items[n])) {
+            integers = FALSE;
+            numbers = items[n] != nilobj &&
+                classField(items[n]) == floatClass;
+        }
+    }
+    if (integers) { return SORT_INTEGERS; }
+    if (numbers) { return SORT_NUMBERS; }
+
+    byteClass = isInteger(items[0]) || items[0] == nilobj
+        ? nilobj : classField(items[0]);
+    if (byteClass != stringClass && byteClass != symbolClass) {
+        return SORT_BLOCK;
+    }
+    for (int n = 1; n < count; n++) {
+        if (isInteger(items[n]) || items[n] == nilobj ||
+                classField(items[n]) != byteClass) {
+            return SORT_BLOCK;
+        }
+    }
+    return SORT_BYTES;
+}// nativeKind
+
+
+static inline double
+numberValue(object x) {
+    return isInteger(x) ? intValue(x) : floatValue(x);
+}// numberValue
+
+// Test whether a must come before b.
+static boolean
+before(struct Sorter *s, object a, object b) {
+    object args[2], result;
+    boolean ok;
+
+    switch (s->kind) {
+    case SORT_INTEGERS:
+        return intValue(a) < intValue(b);
+
+    case SORT_NUMBERS:
+        return numberValue(a) < numberValue(b);
+
+    case SORT_BYTES:
+        return bytesCompare(a, b) < 0;
+
+    case SORT_BLOCK:
+        break;
+    }
+
+    if (s->failed) { return FALSE; }
+
+    args[0] = a;
+    args[1] = b;
+    result = blockCall(s->vm, &s->call, args, &ok);
+    decr(result);
+    s->failed = !ok;
+    return result == trueobj;
+}// before
+
+
+// Sort items[lo..hi) by insertion.
+static void
+insertionSort(struct Sorter *s, object *items, int lo, int hi) {
+    for (int n = lo + 1; n < hi && !s->failed; n++) {
+        object item = items[n];
+        int i = n;
+
+        while (i > lo && before(s, item, items[i - 1])) {
+            items[i] = items[i - 1];
+            i--;
+        }
+        items[i] = item;
+    }
+}// insertionSort
+
+// Merge the sorted items[lo..mid) and items[mid..hi), using tmp for
+// the first of them.  An item of the second run goes first only if it
+// is strictly before, which keeps the sort stable.
+static void
+merge(struct Sorter *s, object *items, object *tmp, int lo, int mid, int hi) {
+    int left = 0, leftEnd = mid - lo, right = mid, out = lo;
+
+    memcpy(tmp, items + lo, leftEnd * sizeof(object));
+    while (left < leftEnd && right < hi) {
+        if (before(s, items[right], tmp[left])) {
+            items[out++] = items[right++];
+        } else {
+            items[out++] = tmp[left++];
+        }
+    }
+    memcpy(items + out, tmp + left, (leftEnd - left) * sizeof(object));
+}// merge
+
+// Merge the sorted runs items[bounds[n]..bounds[n+1]) pairwise until
+// a single run is left.  Overwrites bounds.
+static void
+mergeRuns(struct Sorter *s, object *items, int *bounds, int runs) {
+    object *tmp = ck_realloc(NULL, (bounds[runs] + 1) * sizeof(object));
+
+    while (runs > 1 && !s->failed) {
+        int merged = 0;
+
+        for (int n = 0; n + 1 < runs; n += 2) {
+            merge(s, items, tmp, bounds[n], bounds[n + 1], bounds[n + 2]);
+            bounds[++merged] = bounds[n + 2];
+        }
+        if (runs % 2) {
+            bounds[++merged] = bounds[runs];
+        }
+        runs = merged;
+    }
+
+    free(tmp);
+}// mergeRuns
+
+
+// Sort the memory of a pointer object in place.  Returns FALSE if the
+// sort block couldn't be called.
+static boolean
+sortItems(struct Sorter *s, object *items, int count) {
+    int runs = (count + RUN_LENGTH - 1) / RUN_LENGTH;
+    int *bounds = ck_realloc(NULL, (runs + 1) * sizeof(int));
+
+    for (int n = 0; n < runs; n++) {
+        bounds[n] = n * RUN_LENGTH;
+        insertionSort(s, items, bounds[n],
+                      n == runs - 1 ? count : bounds[n] + RUN_LENGTH);
+    }
+    bounds[runs] = count;
+    mergeRuns(s, items, bounds, runs);
+
+    free(bounds);
+    return !s->failed;
+}// sortItems
+
+// Set up s to sort items, either natively or with block.  Returns
+// FALSE if it can't be done.  Otherwise, endSorter() must be called
+// when the sort is done.
+static boolean
+initSorter(struct Sorter *s, struct VM *vm, object block,
+           object *items, int count) {
+    s->vm = vm;
+    s->failed = FALSE;
+    s->kind = block == nilobj && count > 0
+        ? nativeKind(items, count) : SORT_BLOCK;
+
+    if (s->kind != SORT_BLOCK) { return TRUE; }
+    if (block == nilobj) { return FALSE; }
+    return blockCallStart(vm, &s->call, block, 2);
+}// initSorter
+
+static void
+endSorter(struct Sorter *s) {
+    if (s->kind == SORT_BLOCK) {
+        blockCallEnd(&s->call);
+    }
+}// endSorter
+
+
+static boolean
+isArrayLike(object obj) {
+    return !isInteger(obj) && obj != nilobj && sizeField(obj) >= 0;
+}// isArrayLike
+
+// Return a copy of array sorted by block (or natively, if block is
+// nil), or nil if that can't be done.
+object
+sortArray(struct VM *vm, object array, object block) {
+    int count = sizeField(array);
+    object result = copyFrom(array, 1, count);
+    struct Sorter s;
+
+    // The copy holds the items while the block runs (nothing else can
+    // reach it, so it is safe unreferenced); its slots are only
+    // rearranged, so the reference counts stay right.
+    if (!initSorter(&s, vm, block, sysMemPtr(result), count)) {
+        incr(result);
+        decr(result);
+        return nilobj;
+    }
+    sortItems(&s, sysMemPtr(result), count);
+    endSorter(&s);
+
+    if (s.failed) {
+        incr(result);
+        decr(result);
+        return nilobj;
+    }
+    return result;
+}// sortArray
+
+// Return the items of the sorted Arrays in pieces merged into one
+// sorted Array, or nil if that can't be done.
+object
+mergeArrays(struct VM *vm, object pieces, object block) {
+    int runs = sizeField(pieces);
+    int *bounds = ck_realloc(NULL, (runs + 1) * sizeof(int));
+    object result;
+    object *items;
+    struct Sorter s;
+
+    bounds[0] = 0;
+    for (int n = 0; n < runs; n++) {
+        object piece = basicAt(pieces, n + 1);
+
+        if (!isArrayLike(piece) || bounds[n] + sizeField(piece) > OBJSIZE_MAX) {
+            free(bounds);
+            return nilobj;
+        }
+        bounds[n + 1] = bounds[n] + sizeField(piece);
+    }
+
+    result = newArray(bounds[runs]);
+    items = sysMemPtr(result);
+    for (int n = 0; n < runs; n++) {
+        object piece = basicAt(pieces, n + 1);
+
+        memcpy(items + bounds[n], sysMemPtr(piece),
+               sizeField(piece) * sizeof(object));
+    }
+    for (int n = 0; n < bounds[runs]; n++) {
+        incr(items[n]);
+    }
+
+    if (initSorter(&s, vm, block, items, bounds[runs])) {
+        mergeRuns(&s, items, bounds, runs);
+        endSorter(&s);
+    } else {
+        s.failed = TRUE;
+    }
+    free(bounds);
+
+    if (s.failed) {
+        incr(result);
+        decr(result);
+        return nilobj;
+    }
+    return result;
+}// mergeArrays
+
+
+// Primitives 210-219.
+object
+sortPrimitive(struct VM *vm, int number, object *arguments) {
+    object returnedObject = nilobj;
+
+    if (!isArrayLike(arguments[0])) {
+        return nilobj;
+    }
+
+    switch (number) {
+    case 0:         /* sorted copy, by a block or natively */
+        returnedObject = sortArray(vm, arguments[0], arguments[1]);
+        break;
+
+    case 1:         /* merge sorted Arrays */
+        returnedObject = mergeArrays(vm, arguments[0], arguments[1]);
+        break;
+
+    default:
+        sysError("unknown primitive", "sortPrimitive");
+        break;
+    }
+
+    return returnedObject;
+}// sortPrimitive
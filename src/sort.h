@@ -0,0 +1,12 @@
+/*
+    Native sorting, for Array.
+*/
+
+#ifndef __SORT_H
+#define __SORT_H
+
+extern object sortArray(struct VM *vm, object array, object block);
+extern object mergeArrays(struct VM *vm, object pieces, object block);
+extern object sortPrimitive(struct VM *vm, int number, object *arguments);
+
+#endif
@@ -14,11 +14,15 @@
 #include "tty.h"
 #include "unixio.h"
 #include "interp.h"
+#include "jit.h"
+#include "sched.h"
 
 
 
+// Remove the options from argv and act on them.  Returns the -e
+// script, if any.
 static const char *
-getScript(int *argc, char **argv) {
+getOptions(int *argc, char **argv) {
     const char *script = NULL;
 
     int dest = 0;
@@ -34,6 +38,24 @@ getScript(int *argc, char **argv) {
             continue;
         }
 
+        // Disable the translation tier (see jit.c).
+        if (streq("-Xnojit", argv[src])) {
+            jitEnabled = FALSE;
+            continue;
+        }
+
+        // Use timed slices of the given number of microseconds.
+        if (streq("-Xslice", argv[src])) {
+            if (src + 1 >= *argc || atol(argv[src + 1]) <= 0) {
+                sysError("Bad or missing '-Xslice' argument.", "");
+                exit(1);
+            }
+
+            src++;
+            schedSetSliceTime(atol(argv[src]));
+            continue;
+        }
+
         argv[dest] = argv[src];
         ++dest;
     }
@@ -55,7 +77,10 @@ run() {
         return;
     }
 
-    while (execute(firstProcess, 15000)) {
+    // The system process runs the read-eval-print loop; everything
+    // else it forks is scheduled around it (see sched.c).
+    schedInit(newVM(), firstProcess);
+    while (schedRunSlice()) {
         // ...
     }
 
@@ -74,8 +99,8 @@ main(int argc, char **argv) {
     strcpy(buffer, "systemImage");
     p = buffer;
 
-    // Look for a -e argument.
-    const char *script = getScript(&argc, argv);
+    // Look for a -e argument and any -X options.
+    const char *script = getOptions(&argc, argv);
 
     if (argc != 1) {
         p = argv[1];
@@ -107,6 +132,10 @@ main(int argc, char **argv) {
         setStringValue(launchscriptRef, script);
     }
 
+    // Read stdin unbuffered so that the scheduler can tell when a
+    // line is waiting (see schedWaitForFd()).
+    setvbuf(stdin, NULL, _IONBF, 0);
+
     run();
 
     return 0;
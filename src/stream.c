@@ -0,0 +1,232 @@
+/*
+    Streams over Strings and ByteArrays, for WriteStream and ReadStream.
+
+    A WriteStream appends to a buffer (a String or ByteArray) that is
+    longer than what has been written so far; the stream's position
+    says how much of it is in use.  When the buffer fills up it is
+    replaced by one twice the size, so building a long String takes
+    time in proportion to its length rather than to its square, as
+    repeated catenation with "," does.
+
+    Primitives 230-239 do the appending, print numbers straight into
+    the buffer without making a String for each, and scan a ReadStream
+    for a delimiter.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "memory.h"
+#include "names.h"
+#include "news.h"
+#include "tty.h"
+
+#include "bulk.h"
+#include "stream.h"
+
+enum {
+    STREAM_BUFFER = 1,          // field: the String or ByteArray
+    STREAM_POSITION = 2,        // field: the number of bytes used or read
+
+    MIN_CAPACITY = 32,
+    NUMBER_LENGTH = 40,         // room for any printed SmallInteger or Float
+};
+
+static object charClass = 0;
+
+static inline int
+positionOf(object stream) {
+    return intValue(basicAt(stream, STREAM_POSITION));
+}// positionOf
+
+// The most bytes a stream may hold: its position must stay a
+// SmallInteger and its buffer a valid byte object.
+static inline int
+maxLength(void) {
+    return OBJSIZE_MAX - 1 < OBJINT_MAX ? OBJSIZE_MAX - 1 : OBJINT_MAX;
+}// maxLength
+
+// Check that obj looks like a stream over bytes, so that a stray
+// object can't send the primitives outside its buffer.
+static boolean
+isByteStream(object obj) {
+    object buffer;
+
+    if (!isIndexed(obj) || sizeField(obj) < STREAM_POSITION) {
+        return FALSE;
+    }
+    buffer = basicAt(obj, STREAM_BUFFER);
+    return isBytes(buffer) && isInteger(basicAt(obj, STREAM_POSITION)) &&
+        positionOf(obj) >= 0 && positionOf(obj) <= byteLength(buffer);
+}// isByteStream
+
+
+// Advance the position of a WriteStream by count bytes, doubling its
+// buffer if they don't fit, and return where they go, or NULL if the
+// stream can't get that big.
+static byte *
+reserve(object stream, int count) {
+    object buffer = basicAt(stream, STREAM_BUFFER);
+    int position = positionOf(stream);
+    int capacity = byteLength(buffer);
+
+    if (count > maxLength() - position) { return NULL; }
+
+    if (position + count > capacity) {
+        capacity = capacity * 2 < MIN_CAPACITY ? MIN_CAPACITY : capacity * 2;
+        if (capacity < position + count) { capacity = position + count; }
+        if (capacity > maxLength()) { capacity = maxLength(); }
+
+        buffer = copyResized(buffer, classField(buffer), capacity);
+        fieldAtPut(stream, STREAM_BUFFER, buffer);
+    }
+
+    simpleAtPut(stream, STREAM_POSITION, newInteger(position + count));
+    return bytePtr(buffer) + position;
+}// reserve
+
+static boolean
+append(object stream, const void *bytes, int count) {
+    byte *dest = reserve(stream, count);
+
+    if (!dest) { return FALSE; }
+    memcpy(dest, bytes, count);
+    return TRUE;
+}// append
+
+
+// Write value in base (2 to 36) into buf, which must have room for
+// NUMBER_LENGTH bytes, with digits as Integer>>asDigit makes them.
+// Returns the number of bytes written; no 0 is added.
+int
+formatInteger(char *buf, long value, int base) {
+    static const char digitChars[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    char digits[NUMBER_LENGTH];
+    unsigned long n = value < 0 ? -(unsigned long)value : (unsigned long)value;
+    int count = 0, length = 0;
+
+    do {
+        digits[count++] = digitChars[n % base];
+        n /= base;
+    } while (n);
+
+    if (value < 0) { buf[length++] = '-'; }
+    while (count) { buf[length++] = digits[--count]; }
+    return length;
+}// formatInteger
+
+// Print number (a SmallInteger or Float) into buf as printString
+// would, returning its length, or -1 if it isn't something we can
+// print in that base.
+static int
+formatNumber(char *buf, object number, object base) {
+    if (!isInteger(base) || intValue(base) < 2 || intValue(base) > 36) {
+        return -1;
+    }
+    if (isInteger(number)) {
+        return formatInteger(buf, intValue(number), intValue(base));
+    }
+    if (isIndexed(number) && classField(number) == floatClass &&
+            intValue(base) == 10) {
+        return snprintf(buf, NUMBER_LENGTH, "%g", floatValue(number));
+    }
+    return -1;
+}// formatNumber
+
+// Return the byte value of a Char or of a SmallInteger in 0-255, or
+// -1 if item is neither.
+static int
+byteValue(object item) {
+    if (charClass == nilobj) {
+        charClass = globalSymbol("Char");
+    }
+
+    if (isIndexed(item) && classField(item) == charClass) {
+        item = basicAt(item, 1);
+    }
+    if (isInteger(item) && intValue(item) >= 0 && intValue(item) <= 255) {
+        return intValue(item);
+    }
+    return -1;
+}// byteValue
+
+
+// Primitives 230-239.
+object
+streamPrimitive(int number, object *arguments) {
+    object returnedObject = nilobj;
+    object stream = arguments[0];
+    char buf[NUMBER_LENGTH];
+    int length, value;
+
+    // Primitive 234 formats a number on its own; the rest work on a
+    // stream.
+    if (number == 4) {
+        length = formatNumber(buf, arguments[0], arguments[1]);
+        if (length >= 0) {
+            buf[length] = '\0';
+            returnedObject = newStString(buf);
+        }
+        return returnedObject;
+    }
+
+    if (!isByteStream(stream)) {
+        return nilobj;
+    }
+
+    switch (number) {
+    case 0:         /* nextPutAll: bytes */
+        if (isBytes(arguments[1]) &&
+            append(stream, bytePtr(arguments[1]), byteLength(arguments[1]))) {
+            returnedObject = stream;
+        }
+        break;
+
+    case 1:         /* nextPut: a Char or byte */
+        value = byteValue(arguments[1]);
+        if (value >= 0) {
+            byte *dest = reserve(stream, 1);
+
+            if (dest) {
+                *dest = value;
+                returnedObject = stream;
+            }
+        }
+        break;
+
+    case 2:         /* contents */
+        returnedObject = copyRange(basicAt(stream, STREAM_BUFFER),
+                                   1, positionOf(stream));
+        break;
+
+    case 3:         /* print: a number in a base */
+        length = formatNumber(buf, arguments[1], arguments[2]);
+        if (length >= 0 && append(stream, buf, length)) {
+            returnedObject = stream;
+        }
+        break;
+
+    case 5:         /* ReadStream upTo: a Char or byte */
+        value = byteValue(arguments[1]);
+        if (value >= 0) {
+            object buffer = basicAt(stream, STREAM_BUFFER);
+            int position = positionOf(stream);
+            byte *start = bytePtr(buffer) + position;
+            byte *found = memchr(start, value, byteLength(buffer) - position);
+            int end = found ? found - bytePtr(buffer) : byteLength(buffer);
+
+            returnedObject = copyRange(buffer, position + 1, end);
+            simpleAtPut(stream, STREAM_POSITION,
+                        newInteger(found ? end + 1 : end));
+        }
+        break;
+
+    default:
+        sysError("unknown primitive", "streamPrimitive");
+        break;
+    }
+
+    return returnedObject;
+}// streamPrimitive
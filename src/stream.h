@@ -0,0 +1,11 @@
+/*
+    Native streams over Strings and ByteArrays.
+*/
+
+#ifndef __STREAM_H
+#define __STREAM_H
+
+extern int formatInteger(char *buf, long value, int base);
+extern object streamPrimitive(int number, object *arguments);
+
+#endif
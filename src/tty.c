@@ -13,6 +13,8 @@
 
 #include "common.h"
 #include "memory.h"
+#include "names.h"
+#include "feedback.h"
 
 /* report a fatal system error */
 void sysError(char *s1, char *s2) {
@@ -57,6 +59,18 @@ object sysPrimitive(int number, object * arguments) {
         returnedObject = newInteger(system(charPtr(arguments[0])));
         break;
 
+    case 1:			/* send-site feedback of a method */
+        returnedObject = feedbackFor(arguments[0]);
+        break;
+
+    case 2:			/* turn feedback collection on or off */
+        returnedObject = feedbackEnabled ? trueobj : falseobj;
+        feedbackEnabled = (arguments[0] == trueobj);
+        if (feedbackEnabled) {
+            feedbackReset();
+        }
+        break;
+
     default:
         sysError("unknown primitive", "sysPrimitive");
     }
@@ -7,6 +7,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "common.h"
 #include "memory.h"
@@ -14,6 +15,7 @@
 #include "tty.h"
 #include "news.h"
 #include "filein.h"
+#include "sched.h"
 
 /* Wrappers around fread and fwrite that catch and report IO errors in
  * a Smalltalk-ish way. */
@@ -118,6 +120,14 @@ object ioPrimitive(int number, object * arguments) {
         returnedObject = newStString(buffer);
         break;
 
+    case 6:			/* wait for input */
+        /* only stdin is unbuffered, so only it can be waited on */
+        returnedObject = trueobj;
+        if (fp[i] == stdin && !schedWaitForFd(STDIN_FILENO)) {
+            returnedObject = falseobj;
+        }
+        break;
+
     case 7:			/* write an object image */
         if (fp[i]) {
             imageWrite(fp[i]);
@@ -130,7 +140,7 @@ object ioPrimitive(int number, object * arguments) {
         if (!fp[i]) {
             break;
         }
-        fputs(charPtr(arguments[1]), fp[i]);
+        fwrite(charPtr(arguments[1]), 1, byteLength(arguments[1]), fp[i]);
         if (number == 8) {
             fflush(fp[i]);
         } else {
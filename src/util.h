@@ -18,6 +18,13 @@ static inline void *ck_calloc(size_t count, size_t size) {
     return result;
 }
 
+// Call realloc(), failing on error.
+static inline void *ck_realloc(void *ptr, size_t size) {
+    void *result = realloc(ptr, size);
+    if (!result) { sysError("Memory error: realloc() failed.",""); }
+    return result;
+}
+
 // This is wrong (assumes 16-bit int) but I'm keeping it for now until
 // I get a better set of tests.
 static inline int longCanBeInt(long l) {
@@ -0,0 +1,526 @@
+/*
+    Unboxed numeric arrays, for FloatArray and IntegerArray.
+
+    An Array of numbers holds a separate Float object for every element
+    that isn't a SmallInteger, and arithmetic on it allocates one for
+    every result.  A FloatArray is instead a byte object holding raw
+    doubles, and an IntegerArray one holding raw 32-bit integers;
+    numbers are only boxed when a single element is fetched.
+
+    Primitives 250-255 create them, fetch and store elements, and work
+    on them whole: elementwise arithmetic with another array or a
+    scalar, sums, dot products, minimum and maximum, and a few unary
+    functions.  Where SSE2 is available (it always is on x86-64) the
+    double and integer addition and subtraction kernels, the float
+    multiplication and division and the float reductions work two or
+    four elements at a time; everything else, and every other machine,
+    uses the plain loops that follow them.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "common.h"
+#include "memory.h"
+#include "names.h"
+#include "news.h"
+#include "tty.h"
+#include "util.h"
+
+#include "bulk.h"
+#include "longint.h"
+#include "vector.h"
+
+enum VectorKind {
+    VEC_NONE,                   // not a numeric array
+    VEC_FLOAT,                  // FloatArray: doubles
+    VEC_INT,                    // IntegerArray: int32_t
+};
+
+// Operations, as numbered by the Smalltalk side.
+enum {
+    OP_ADD = 0, OP_SUB, OP_MUL, OP_DIV,             // primitive 253
+    OP_SUM = 0, OP_MIN, OP_MAX, OP_DOT,             // primitive 254
+    OP_SQRT = 0, OP_ABS, OP_NEGATED, OP_AS_ARRAY, OP_SIZE,  // primitive 255
+};
+
+static object floatArrayClass = 0, integerArrayClass = 0;
+
+static void
+findClasses(void) {
+    if (floatArrayClass == nilobj) {
+        floatArrayClass = globalSymbol("FloatArray");
+        integerArrayClass = globalSymbol("IntegerArray");
+    }
+}// findClasses
+
+static enum VectorKind
+kindOfClass(object cls) {
+    findClasses();
+    return cls == floatArrayClass   ? VEC_FLOAT :
+           cls == integerArrayClass ? VEC_INT   : VEC_NONE;
+}// kindOfClass
+
+static enum VectorKind
+kindOf(object obj) {
+    return isBytes(obj) ? kindOfClass(classField(obj)) : VEC_NONE;
+}// kindOf
+
+static inline int
+elementSize(enum VectorKind kind) {
+    return kind == VEC_FLOAT ? sizeof(double) : sizeof(int32_t);
+}// elementSize
+
+static inline int
+countOf(object vec) {
+    return byteLength(vec) / elementSize(kindOf(vec));
+}// countOf
+
+// The elements of a vector; its memory comes from calloc(), so it is
+// aligned for either kind.
+static inline double *
+floatsOf(object vec) {
+    return (double *) bytePtr(vec);
+}// floatsOf
+
+static inline int32_t *
+intsOf(object vec) {
+    return (int32_t *) bytePtr(vec);
+}// intsOf
+
+// Return a new zeroed vector of count elements, or nil if it would be
+// too big.
+static object
+newVector(enum VectorKind kind, int count) {
+    object result;
+
+    if (count < 0 || count > (OBJSIZE_MAX - 2) / elementSize(kind)) {
+        return nilobj;
+    }
+    result = allocByte(count * elementSize(kind));
+    setClass(result, kind == VEC_FLOAT ? floatArrayClass : integerArrayClass);
+    return result;
+}// newVector
+
+
+// Set *d to the value of a Float or SmallInteger.
+static boolean
+floatArg(object x, double *d) {
+    if (isInteger(x)) {
+        *d = intValue(x);
+        return TRUE;
+    }
+    if (isIndexed(x) && classField(x) == floatClass) {
+        *d = floatValue(x);
+        return TRUE;
+    }
+    return FALSE;
+}// floatArg
+
+static object
+boxInt(long value) {
+    return longCanBeInt(value) ? newInteger(value) : longIntegerFrom(value);
+}// boxInt
+
+
+/*
+    Kernels.  Each works on n elements; b is NULL when the other operand
+    is the scalar.
+*/
+
+static void
+floatKernel(int op, double *r, const double *a, const double *b,
+            double scalar, int n) {
+    int i = 0;
+
+#ifdef __SSE2__
+    __m128d s = _mm_set1_pd(scalar);
+
+    for (; i + 2 <= n; i += 2) {
+        __m128d x = _mm_loadu_pd(a + i);
+        __m128d y = b ? _mm_loadu_pd(b + i) : s;
+
+        switch (op) {
+        case OP_ADD: x = _mm_add_pd(x, y); break;
+        case OP_SUB: x = _mm_sub_pd(x, y); break;
+        case OP_MUL: x = _mm_mul_pd(x, y); break;
+        default:     x = _mm_div_pd(x, y); break;
+        }
+        _mm_storeu_pd(r + i, x);
+    }
+#endif
+
+    for (; i < n; i++) {
+        double y = b ? b[i] : scalar;
+
+        switch (op) {
+        case OP_ADD: r[i] = a[i] + y; break;
+        case OP_SUB: r[i] = a[i] - y; break;
+        case OP_MUL: r[i] = a[i] * y; break;
+        default:     r[i] = a[i] / y; break;
+        }
+    }
+}// floatKernel
+
+// As floatKernel(), but 32-bit integers wrap around on overflow and
+// division truncates.  Returns FALSE on division by zero.
+static boolean
+intKernel(int op, int32_t *r, const int32_t *a, const int32_t *b,
+          int32_t scalar, int n) {
+    int i = 0;
+
+    if (op == OP_DIV) {
+        for (int j = 0; j < n; j++) {
+            if ((b ? b[j] : scalar) == 0) { return FALSE; }
+        }
+    }
+
+#ifdef __SSE2__
+    if (op == OP_ADD || op == OP_SUB) {
+        __m128i s = _mm_set1_epi32(scalar);
+
+        for (; i + 4 <= n; i += 4) {
+            __m128i x = _mm_loadu_si128((const __m128i *) (a + i));
+            __m128i y = b ? _mm_loadu_si128((const __m128i *) (b + i)) : s;
+
+            x = op == OP_ADD ? _mm_add_epi32(x, y) : _mm_sub_epi32(x, y);
+            _mm_storeu_si128((__m128i *) (r + i), x);
+        }
+    }
+#endif
+
+    for (; i < n; i++) {
+        uint32_t x = a[i], y = b ? b[i] : scalar;
+
+        switch (op) {
+        case OP_ADD: r[i] = (int32_t) (x + y); break;
+        case OP_SUB: r[i] = (int32_t) (x - y); break;
+        case OP_MUL: r[i] = (int32_t) (x * y); break;
+        default:
+            // Avoid the one quotient that overflows.
+            r[i] = (int32_t) y == -1 ? (int32_t) (0u - x)
+                                     : a[i] / (int32_t) y;
+            break;
+        }
+    }
+    return TRUE;
+}// intKernel
+
+// Sum of a[i] * b[i], or of a[i] if b is NULL.
+static double
+floatSum(const double *a, const double *b, int n) {
+    double total = 0.0;
+    int i = 0;
+
+#ifdef __SSE2__
+    __m128d acc = _mm_setzero_pd();
+    double lanes[2];
+
+    for (; i + 2 <= n; i += 2) {
+        __m128d x = _mm_loadu_pd(a + i);
+
+        if (b) { x = _mm_mul_pd(x, _mm_loadu_pd(b + i)); }
+        acc = _mm_add_pd(acc, x);
+    }
+    _mm_storeu_pd(lanes, acc);
+    total = lanes[0] + lanes[1];
+#endif
+
+    for (; i < n; i++) {
+        total += b ? a[i] * b[i] : a[i];
+    }
+    return total;
+}// floatSum
+
+// The least (or greatest) of the n > 0 elements of a.
+static double
+floatExtreme(const double *a, int n, boolean greatest) {
+    double best = a[0];
+    int i = 0;
+
+#ifdef __SSE2__
+    if (n >= 2) {
+        __m128d acc = _mm_loadu_pd(a);
+        double lanes[2];
+
+        for (i = 2; i + 2 <= n; i += 2) {
+            __m128d x = _mm_loadu_pd(a + i);
+
+            acc = greatest ? _mm_max_pd(acc, x) : _mm_min_pd(acc, x);
+        }
+        _mm_storeu_pd(lanes, acc);
+        best = (greatest ? lanes[1] > lanes[0] : lanes[1] < lanes[0])
+            ? lanes[1] : lanes[0];
+    }
+#endif
+
+    for (; i < n; i++) {
+        if (greatest ? a[i] > best : a[i] < best) { best = a[i]; }
+    }
+    return best;
+}// floatExtreme
+
+static long
+intSum(const int32_t *a, const int32_t *b, int n) {
+    long total = 0;
+
+    for (int i = 0; i < n; i++) {
+        total += b ? (long) a[i] * b[i] : a[i];
+    }
+    return total;
+}// intSum
+
+static int32_t
+intExtreme(const int32_t *a, int n, boolean greatest) {
+    int32_t best = a[0];
+
+    for (int i = 1; i < n; i++) {
+        if (greatest ? a[i] > best : a[i] < best) { best = a[i]; }
+    }
+    return best;
+}// intExtreme
+
+
+// Return a new vector of the given kind made from source: a size, an
+// Array of numbers or a vector of either kind.  Returns nil if that
+// can't be done.
+static object
+makeVector(enum VectorKind kind, object source) {
+    enum VectorKind sourceKind = kindOf(source);
+    object result;
+    int count;
+
+    if (isInteger(source)) {
+        return newVector(kind, intValue(source));
+    }
+    if (!isIndexed(source) || (sourceKind == VEC_NONE && sizeField(source) < 0)) {
+        return nilobj;
+    }
+
+    count = sourceKind == VEC_NONE ? sizeField(source) : countOf(source);
+    result = newVector(kind, count);
+    if (result == nilobj) { return nilobj; }
+
+    for (int i = 0; i < count; i++) {
+        double d;
+
+        if (sourceKind == VEC_FLOAT) {
+            d = floatsOf(source)[i];
+        } else if (sourceKind == VEC_INT) {
+            d = intsOf(source)[i];
+        } else if (!floatArg(basicAt(source, i + 1), &d) ||
+                   (kind == VEC_INT && !isInteger(basicAt(source, i + 1)))) {
+            incr(result);
+            decr(result);
+            return nilobj;
+        }
+
+        if (kind == VEC_FLOAT) {
+            floatsOf(result)[i] = d;
+        } else {
+            intsOf(result)[i] = (int32_t) d;
+        }
+    }
+    return result;
+}// makeVector
+
+// Return a new Array of the elements of vec, boxed.
+static object
+vectorAsArray(object vec) {
+    int count = countOf(vec);
+    object result = newArray(count);
+
+    for (int i = 0; i < count; i++) {
+        basicAtPut(result, i + 1, kindOf(vec) == VEC_FLOAT
+                                  ? newFloat(floatsOf(vec)[i])
+                                  : boxInt(intsOf(vec)[i]));
+    }
+    return result;
+}// vectorAsArray
+
+// Elementwise a op b, where b is a vector like a or a scalar.
+static object
+vectorBinary(object a, object b, int op) {
+    enum VectorKind kind = kindOf(a);
+    int count = countOf(a);
+    boolean isVector = kindOf(b) != VEC_NONE;
+    object result;
+    double scalar = 0.0;
+
+    if (isVector ? kindOf(b) != kind || countOf(b) != count
+                 : !floatArg(b, &scalar) ||
+                   (kind == VEC_INT && !isInteger(b))) {
+        return nilobj;
+    }
+
+    result = newVector(kind, count);
+    if (kind == VEC_FLOAT) {
+        floatKernel(op, floatsOf(result), floatsOf(a),
+                    isVector ? floatsOf(b) : NULL, scalar, count);
+    } else if (!intKernel(op, intsOf(result), intsOf(a),
+                          isVector ? intsOf(b) : NULL, (int32_t) scalar,
+                          count)) {
+        incr(result);
+        decr(result);
+        return nilobj;
+    }
+    return result;
+}// vectorBinary
+
+static object
+vectorReduce(object a, int op, object b) {
+    enum VectorKind kind = kindOf(a);
+    int count = countOf(a);
+
+    if (op == OP_DOT && (kindOf(b) != kind || countOf(b) != count)) {
+        return nilobj;
+    }
+    if ((op == OP_MIN || op == OP_MAX) && count == 0) {
+        return nilobj;
+    }
+
+    if (kind == VEC_FLOAT) {
+        switch (op) {
+        case OP_SUM: return newFloat(floatSum(floatsOf(a), NULL, count));
+        case OP_DOT: return newFloat(floatSum(floatsOf(a), floatsOf(b), count));
+        default:
+            return newFloat(floatExtreme(floatsOf(a), count, op == OP_MAX));
+        }
+    }
+
+    switch (op) {
+    case OP_SUM: return boxInt(intSum(intsOf(a), NULL, count));
+    case OP_DOT: return boxInt(intSum(intsOf(a), intsOf(b), count));
+    default:     return boxInt(intExtreme(intsOf(a), count, op == OP_MAX));
+    }
+}// vectorReduce
+
+static object
+vectorUnary(object a, int op) {
+    enum VectorKind kind = kindOf(a);
+    int count = countOf(a);
+    object result;
+
+    switch (op) {
+    case OP_SQRT:
+        result = kind == VEC_FLOAT ? newVector(VEC_FLOAT, count)
+                                   : makeVector(VEC_FLOAT, a);
+        if (kind == VEC_FLOAT) {
+            memcpy(floatsOf(result), floatsOf(a), count * sizeof(double));
+        }
+        {
+            double *r = floatsOf(result);
+            int i = 0;
+
+#ifdef __SSE2__
+            for (; i + 2 <= count; i += 2) {
+                _mm_storeu_pd(r + i, _mm_sqrt_pd(_mm_loadu_pd(r + i)));
+            }
+#endif
+            for (; i < count; i++) {
+                r[i] = sqrt(r[i]);
+            }
+        }
+        return result;
+
+    case OP_ABS:
+    case OP_NEGATED:
+        result = newVector(kind, count);
+        for (int i = 0; i < count; i++) {
+            if (kind == VEC_FLOAT) {
+                double x = floatsOf(a)[i];
+
+                floatsOf(result)[i] = op == OP_NEGATED ? -x : fabs(x);
+            } else {
+                uint32_t x = intsOf(a)[i];
+
+                intsOf(result)[i] = (int32_t) (op == OP_NEGATED || intsOf(a)[i] < 0
+                                               ? 0u - x : x);
+            }
+        }
+        return result;
+
+    case OP_AS_ARRAY:
+        return vectorAsArray(a);
+
+    case OP_SIZE:
+        return newInteger(count);
+    }
+    return nilobj;
+}// vectorUnary
+
+
+// Primitives 250-255.
+object
+vectorPrimitive(int number, object *arguments) {
+    object returnedObject = nilobj;
+    object vec = arguments[0];
+    int index;
+    double d;
+
+    // Primitive 250 makes a vector; the rest work on one.
+    if (number == 0) {
+        enum VectorKind kind = kindOfClass(arguments[0]);
+
+        return kind == VEC_NONE ? nilobj : makeVector(kind, arguments[1]);
+    }
+    if (kindOf(vec) == VEC_NONE) {
+        return nilobj;
+    }
+
+    switch (number) {
+    case 1:         /* at: */
+    case 2:         /* at:put: */
+        index = isInteger(arguments[1]) ? intValue(arguments[1]) : 0;
+        if (index < 1 || index > countOf(vec)) {
+            break;
+        }
+        if (number == 1) {
+            returnedObject = kindOf(vec) == VEC_FLOAT
+                ? newFloat(floatsOf(vec)[index - 1])
+                : boxInt(intsOf(vec)[index - 1]);
+        } else if (kindOf(vec) == VEC_FLOAT && floatArg(arguments[2], &d)) {
+            floatsOf(vec)[index - 1] = d;
+            returnedObject = arguments[2];
+        } else if (kindOf(vec) == VEC_INT && isInteger(arguments[2])) {
+            intsOf(vec)[index - 1] = intValue(arguments[2]);
+            returnedObject = arguments[2];
+        }
+        break;
+
+    case 3:         /* elementwise + - * / */
+        if (isInteger(arguments[2]) && intValue(arguments[2]) >= OP_ADD &&
+            intValue(arguments[2]) <= OP_DIV) {
+            returnedObject = vectorBinary(vec, arguments[1],
+                                          intValue(arguments[2]));
+        }
+        break;
+
+    case 4:         /* sum, min, max, dot: */
+        if (isInteger(arguments[1]) && intValue(arguments[1]) >= OP_SUM &&
+            intValue(arguments[1]) <= OP_DOT) {
+            returnedObject = vectorReduce(vec, intValue(arguments[1]),
+                                          arguments[2]);
+        }
+        break;
+
+    case 5:         /* sqrt, abs, negated, asArray, size */
+        if (isInteger(arguments[1])) {
+            returnedObject = vectorUnary(vec, intValue(arguments[1]));
+        }
+        break;
+
+    default:
+        sysError("unknown primitive", "vectorPrimitive");
+        break;
+    }
+
+    return returnedObject;
+}// vectorPrimitive
@@ -0,0 +1,10 @@
+/*
+    Unboxed numeric arrays, for FloatArray and IntegerArray.
+*/
+
+#ifndef __VECTOR_H
+#define __VECTOR_H
+
+extern object vectorPrimitive(int number, object *arguments);
+
+#endif
@@ -0,0 +1,676 @@
+/*
+    Worker VMs.
+
+    A worker is a copy of the running VM in a child OS process,
+    started with fork() from the middle of a primitive.  The child
+    keeps only the Smalltalk process that started it (see
+    schedIsolate()), which then loops answering requests from its
+    parent (see Worker in mult.st).  Since both sides have their own
+    object memory, they can run on separate cores without sharing
+    anything.
+
+    Parent and child talk over a pair of pipes.  Each message is an
+    object graph, serialized as a 4-byte length followed by a tagged,
+    depth-first encoding of the objects:
+
+        'n' 't' 'f'             nil, true and false
+        'i' <int32>             a SmallInteger
+        'r' <int32>             the nth object already in this message
+        'y' <name>              a Symbol (interned again on arrival)
+        'k' <name>              a Class (looked up by name on arrival)
+        'o' <class> <n> <n objects>     any other pointer object
+        'b' <class> <n> <n bytes>       any other byte object
+
+    where <name> and <class> are a length-prefixed string.  Objects
+    are numbered in the order they are first written, so an object
+    referred to more than once (a shared String, say, or a cycle) is
+    sent once and arrives shared the same way.  Nesting is limited to
+    WORKER_MAX_DEPTH.  Blocks, contexts, methods and processes can't
+    be sent, since they only make sense inside one image.
+
+    Dictionaries and Sets keep the hashes of their keys (see dict.c),
+    and many of those are object table indexes, which are different
+    on the receiving side.  So the receiver gets a list of the ones in
+    the message along with it, and Worker>>receive rehashes them.
+
+    Receiving a message blocks only the receiving Smalltalk process
+    (see schedWaitForFd()).  Sending writes the whole message at once,
+    so a worker's replies should be read regularly.  SIGPIPE is ignored
+    once there are workers, so that sending to one that has exited
+    just fails.
+*/
+
+#define _XOPEN_SOURCE 600       // for fork(), pipe(), etc.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "common.h"
+#include "memory.h"
+#include "names.h"
+#include "news.h"
+#include "tty.h"
+#include "sched.h"
+#include "util.h"
+
+#include "worker.h"
+
+// Channel 0 is the connection to our parent (if we are a worker);
+// the rest are connections to our own workers.
+static struct Channel {
+    pid_t pid;              // the worker, or 0 if the slot is free
+    int in, out;            // pipe ends we read and write
+} channels[WORKER_MAX + 1];
+
+static boolean isWorker = FALSE;
+
+
+/*
+    Encoding.
+*/
+
+struct Buffer {
+    byte *data;
+    int size, capacity;
+    boolean ok;             // FALSE if something couldn't be encoded
+    int count;              // the number of objects numbered so far
+};
+
+// The number given to each object in the message being encoded (plus
+// one, so that 0 means none yet), indexed by object table index.
+// encode() records each object it numbers in 'numbered' so that
+// sendObject() can clear just those entries again.
+static int numbers[OBJECT_TABLE_MAX];
+static object *numbered;
+static int numberedCapacity;
+
+static void
+put(struct Buffer *b, const void *data, int size) {
+    if (b->size + size > b->capacity) {
+        b->capacity = (b->size + size) * 2;
+        b->data = ck_realloc(b->data, b->capacity);
+    }
+    memcpy(b->data + b->size, data, size);
+    b->size += size;
+}// put
+
+static void
+putInt(struct Buffer *b, int32_t value) {
+    put(b, &value, sizeof(value));
+}// putInt
+
+static void
+putTag(struct Buffer *b, char tag) {
+    put(b, &tag, 1);
+}// putTag
+
+static void
+putName(struct Buffer *b, const char *name) {
+    putInt(b, strlen(name));
+    put(b, name, strlen(name));
+}// putName
+
+static const char *
+classNameOf(object obj) {
+    return charPtr(basicAt(getClass(obj), OFST_class_name));
+}// classNameOf
+
+static boolean
+isSendable(const char *className) {
+    static const char *unsendable[] = {
+        "Block", "Context", "Method", "Process", NULL
+    };
+
+    for (int n = 0; unsendable[n]; n++) {
+        if (streq(className, unsendable[n])) { return FALSE; }
+    }
+    return TRUE;
+}// isSendable
+
+static void
+encode(struct Buffer *b, object obj, int depth) {
+    const char *className;
+    int size;
+
+    if (obj == nilobj)      { putTag(b, 'n'); return; }
+    if (obj == trueobj)     { putTag(b, 't'); return; }
+    if (obj == falseobj)    { putTag(b, 'f'); return; }
+
+    if (isInteger(obj)) {
+        putTag(b, 'i');
+        putInt(b, intValue(obj));
+        return;
+    }
+
+    className = classNameOf(obj);
+    if (depth > WORKER_MAX_DEPTH || !isSendable(className)) {
+        if (b->ok) {
+            sysWarn("can't send object to worker:", (char *) className);
+        }
+        b->ok = FALSE;
+        putTag(b, 'n');
+        return;
+    }
+
+    if (streq(className, "Symbol")) {
+        putTag(b, 'y');
+        putName(b, charPtr(obj));
+        return;
+    }
+
+    if (streq(className, "Class")) {
+        putTag(b, 'k');
+        putName(b, charPtr(basicAt(obj, OFST_class_name)));
+        return;
+    }
+
+    if (numbers[oNdx(obj)]) {
+        putTag(b, 'r');
+        putInt(b, numbers[oNdx(obj)] - 1);
+        return;
+    }
+    if (b->count == numberedCapacity) {
+        numberedCapacity = numberedCapacity ? numberedCapacity * 2 : 64;
+        numbered = ck_realloc(numbered, numberedCapacity * sizeof(object));
+    }
+    numbered[b->count++] = obj;
+    numbers[oNdx(obj)] = b->count;
+
+    size = sizeField(obj);
+    if (size < 0) {
+        putTag(b, 'b');
+        putName(b, className);
+        putInt(b, byteLength(obj));
+        put(b, bytePtr(obj), byteLength(obj));
+        return;
+    }
+
+    putTag(b, 'o');
+    putName(b, className);
+    putInt(b, size);
+    for (int n = 1; n <= size; n++) {
+        encode(b, basicAt(obj, n), depth + 1);
+    }
+}// encode
+
+
+/*
+    Decoding.  The message has been checked to be complete, but not
+    that it makes sense, so every read is bounds-checked.
+*/
+
+struct Reader {
+    const byte *p, *end;
+    boolean ok;
+    object *objects;        // the objects numbered so far, in order
+    int count, capacity;
+    object *tables;         // the Dictionaries and Sets among them
+    int tableCount, tableCapacity;
+};
+
+static object dictionaryClass = 0, setClassObj = 0;
+
+// Test if cls is Dictionary, Set or a subclass of either.
+static boolean
+isHashedClass(object cls) {
+    if (dictionaryClass == nilobj) {
+        dictionaryClass = globalSymbol("Dictionary");
+        setClassObj = globalSymbol("Set");
+    }
+
+    for (; cls != nilobj; cls = basicAt(cls, OFST_class_superClass)) {
+        if (cls == dictionaryClass || cls == setClassObj) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}// isHashedClass
+
+static void
+addObject(struct Reader *r, object obj) {
+    if (r->count == r->capacity) {
+        r->capacity = r->capacity ? r->capacity * 2 : 64;
+        r->objects = ck_realloc(r->objects, r->capacity * sizeof(object));
+    }
+    r->objects[r->count++] = obj;
+}// addObject
+
+static boolean
+get(struct Reader *r, void *data, int size) {
+    if (!r->ok || size < 0 || r->end - r->p < size) {
+        r->ok = FALSE;
+        return FALSE;
+    }
+    memcpy(data, r->p, size);
+    r->p += size;
+    return TRUE;
+}// get
+
+static int32_t
+getInt(struct Reader *r) {
+    int32_t value = 0;
+    get(r, &value, sizeof(value));
+    return value;
+}// getInt
+
+// Read a name into buffer (of TOKEN_MAX bytes).
+static char *
+getName(struct Reader *r, char *buffer) {
+    int32_t size = getInt(r);
+
+    if (size >= TOKEN_MAX || !get(r, buffer, size)) {
+        r->ok = FALSE;
+        size = 0;
+    }
+    buffer[size] = '\0';
+    return buffer;
+}// getName
+
+static object
+decode(struct Reader *r) {
+    char tag = 'n', name[TOKEN_MAX];
+    object cls, obj;
+    int32_t size;
+
+    get(r, &tag, 1);
+    if (!r->ok) { return nilobj; }
+
+    switch (tag) {
+    case 'n':   return nilobj;
+    case 't':   return trueobj;
+    case 'f':   return falseobj;
+    case 'i':   return newInteger(getInt(r));
+    case 'y':   return newSymbol(getName(r, name));
+    case 'k':   return globalSymbol(getName(r, name));
+
+    case 'r':
+        size = getInt(r);
+        if (size < 0 || size >= r->count) {
+            r->ok = FALSE;
+            return nilobj;
+        }
+        return r->objects[size];
+    }
+
+    // Every object takes at least a byte of the message, so a size
+    // bigger than what is left is garbage; don't allocate it first.
+    cls = globalSymbol(getName(r, name));
+    size = getInt(r);
+    if (!r->ok || cls == nilobj || size < 0 || size > r->end - r->p ||
+        (tag == 'b' && size + 1 > OBJSIZE_MAX) ||
+        (tag == 'o' && size > OBJSIZE_MAX) ||
+        (tag != 'b' && tag != 'o')) {
+        r->ok = FALSE;
+        return nilobj;
+    }
+
+    if (tag == 'b') {
+        obj = allocByte(size);
+        setClass(obj, cls);
+        addObject(r, obj);
+        get(r, bytePtr(obj), size);
+        return obj;
+    }
+
+    obj = allocObject(size);
+    setClass(obj, cls);
+    addObject(r, obj);
+    for (int n = 1; n <= size && r->ok; n++) {
+        basicAtPut(obj, n, decode(r));
+    }
+
+    // Listed once complete, so that one used as a key in another is
+    // rehashed first.
+    if (isHashedClass(cls)) {
+        if (r->tableCount == r->tableCapacity) {
+            r->tableCapacity = r->tableCapacity ? r->tableCapacity * 2 : 8;
+            r->tables = ck_realloc(r->tables,
+                                   r->tableCapacity * sizeof(object));
+        }
+        r->tables[r->tableCount++] = obj;
+    }
+    return obj;
+}// decode
+
+// Free the objects r has made so far, which nothing else refers to.
+// Each gets an extra reference first, so that none is freed along
+// with another before its own turn comes.
+static void
+releaseObjects(struct Reader *r) {
+    for (int n = 0; n < r->count; n++) {
+        incr(r->objects[n]);
+    }
+    for (int n = 0; n < r->count; n++) {
+        decr(r->objects[n]);
+    }
+    free(r->objects);
+    free(r->tables);
+}// releaseObjects
+
+
+
+/*
+    Channels.
+*/
+
+static boolean
+writeAll(int fd, const byte *data, int size) {
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n <= 0) { return FALSE; }
+        data += n;
+        size -= n;
+    }
+    return TRUE;
+}// writeAll
+
+static boolean
+readAll(int fd, byte *data, int size) {
+    while (size > 0) {
+        ssize_t n = read(fd, data, size);
+        if (n <= 0) { return FALSE; }
+        data += n;
+        size -= n;
+    }
+    return TRUE;
+}// readAll
+
+static void
+closeChannel(struct Channel *ch) {
+    close(ch->in);
+    close(ch->out);
+    if (ch->pid > 0) {
+        waitpid(ch->pid, NULL, 0);
+    }
+    *ch = (struct Channel) { 0, -1, -1 };
+}// closeChannel
+
+// Return the open channel with the given index or NULL.
+static struct Channel *
+channelAt(object index) {
+    int n = isInteger(index) ? intValue(index) : -1;
+
+    if (n < 0 || n > WORKER_MAX || channels[n].pid == 0) { return NULL; }
+    return &channels[n];
+}// channelAt
+
+
+// Start a worker.  Returns its channel index to the parent and 0 to
+// the worker itself, or -1 if it couldn't be started.
+static int
+spawn(void) {
+    int toChild[2], fromChild[2];
+    int slot;
+    pid_t pid;
+
+    for (slot = 1; slot <= WORKER_MAX && channels[slot].pid; slot++) {}
+    if (slot > WORKER_MAX) {
+        sysWarn("too many workers", "");
+        return -1;
+    }
+
+    // Writing to a worker that has exited should fail, not kill us.
+    signal(SIGPIPE, SIG_IGN);
+
+    if (pipe(toChild) < 0) { return -1; }
+    if (pipe(fromChild) < 0) {
+        close(toChild[0]);
+        close(toChild[1]);
+        return -1;
+    }
+
+    // Otherwise, whatever is buffered gets written twice.
+    fflush(stdout);
+    fflush(stderr);
+
+    pid = fork();
+    if (pid < 0) {
+        close(toChild[0]);
+        close(toChild[1]);
+        close(fromChild[0]);
+        close(fromChild[1]);
+        return -1;
+    }
+
+    if (pid > 0) {
+        close(toChild[0]);
+        close(fromChild[1]);
+        channels[slot] = (struct Channel) { pid, fromChild[0], toChild[1] };
+        return slot;
+    }
+
+    // In the worker: drop our parent's other connections (so that its
+    // workers see end-of-file when it closes them) and everyone else.
+    for (int n = 0; n <= WORKER_MAX; n++) {
+        if (channels[n].pid) {
+            close(channels[n].in);
+            close(channels[n].out);
+            channels[n].pid = 0;
+        }
+    }
+    close(toChild[1]);
+    close(fromChild[0]);
+    channels[0] = (struct Channel) { getppid(), toChild[0], fromChild[1] };
+    isWorker = TRUE;
+
+    schedIsolate();
+    return 0;
+}// spawn
+
+
+// Send obj down ch.  Returns FALSE if it couldn't all be sent.
+static boolean
+sendObject(struct Channel *ch, object obj) {
+    struct Buffer b = { NULL, 0, 0, TRUE, 0 };
+    boolean ok;
+
+    putInt(&b, 0);          // the length, filled in below
+    encode(&b, obj, 0);
+    *(int32_t *) b.data = b.size - sizeof(int32_t);
+
+    for (int n = 0; n < b.count; n++) {
+        numbers[oNdx(numbered[n])] = 0;
+    }
+
+    ok = writeAll(ch->out, b.data, b.size) && b.ok;
+    free(b.data);
+    return ok;
+}// sendObject
+
+// Receive an object from ch (which must be readable), returning an
+// Array of it and an Array of the Dictionaries and Sets in it.
+// Returns nilobj and sets *eof at end of file or if the message is
+// garbled.
+static object
+receiveObject(struct Channel *ch, boolean *eof) {
+    int32_t size;
+    struct Reader r;
+    byte *data;
+    object obj, tables, result;
+
+    *eof = FALSE;
+    if (!readAll(ch->in, (byte *) &size, sizeof(size)) || size < 0) {
+        *eof = TRUE;
+        return nilobj;
+    }
+
+    data = ck_realloc(NULL, size ? size : 1);
+    if (!readAll(ch->in, data, size)) {
+        free(data);
+        *eof = TRUE;
+        return nilobj;
+    }
+
+    r = (struct Reader) { data, data + size, TRUE, NULL, 0, 0, NULL, 0, 0 };
+    obj = decode(&r);
+
+    if (!r.ok) {
+        sysWarn("garbled message from worker", "");
+        releaseObjects(&r);
+        free(data);
+        *eof = TRUE;
+        return nilobj;
+    }
+
+    tables = newArray(r.tableCount);
+    for (int n = 0; n < r.tableCount; n++) {
+        basicAtPut(tables, n + 1, r.tables[n]);
+    }
+    result = newArray(2);
+    basicAtPut(result, 1, obj);
+    basicAtPut(result, 2, tables);
+
+    free(r.objects);
+    free(r.tables);
+    free(data);
+    return result;
+}// receiveObject
+
+
+/*
+    Splitting collections up for the parallel operations in collect.st
+    and joining the results again.
+*/
+
+// Return an Array of (at most) count pieces of obj, as even in size
+// as possible and of the same class as obj.
+static object
+chunksOf(object obj, int count) {
+    int size = sizeField(obj);
+    boolean bytes = size < 0;
+    object chunks;
+
+    if (bytes) { size = byteLength(obj); }
+    if (count > size) { count = size; }
+    if (count < 1) { count = 1; }
+
+    chunks = newArray(count);
+    for (int n = 0; n < count; n++) {
+        int low = (int) ((long) n * size / count);
+        int high = (int) ((long) (n + 1) * size / count);
+        object chunk;
+
+        if (bytes) {
+            chunk = allocByte(high - low);
+            memcpy(bytePtr(chunk), bytePtr(obj) + low, high - low);
+        } else {
+            chunk = allocObject(high - low);
+            for (int i = low; i < high; i++) {
+                basicAtPut(chunk, i - low + 1, basicAt(obj, i + 1));
+            }
+        }
+        setClass(chunk, getClass(obj));
+        basicAtPut(chunks, n + 1, chunk);
+    }
+
+    return chunks;
+}// chunksOf
+
+// Concatenate the Arrays in the Array 'pieces', or return nilobj if
+// they aren't all Arrays.
+static object
+join(object pieces) {
+    int total = 0, at = 1;
+    object result;
+
+    for (int n = 1; n <= sizeField(pieces); n++) {
+        object piece = basicAt(pieces, n);
+        if (isInteger(piece) || piece == nilobj || sizeField(piece) < 0) {
+            return nilobj;
+        }
+        total += sizeField(piece);
+    }
+    if (total > OBJSIZE_MAX) { return nilobj; }
+
+    result = newArray(total);
+    for (int n = 1; n <= sizeField(pieces); n++) {
+        object piece = basicAt(pieces, n);
+        for (int i = 1; i <= sizeField(piece); i++) {
+            basicAtPut(result, at++, basicAt(piece, i));
+        }
+    }
+
+    return result;
+}// join
+
+
+// Primitives 180-189.
+object
+workerPrimitive(int number, object *arguments) {
+    object returnedObject = nilobj;
+    struct Channel *ch;
+    boolean eof;
+    int slot;
+
+    switch (number) {
+    case 0:         /* start a worker */
+        slot = spawn();
+        if (slot >= 0) {
+            returnedObject = newInteger(slot);
+        }
+        break;
+
+    case 1:         /* send an object to a worker (or our parent) */
+        ch = channelAt(arguments[0]);
+        returnedObject = (ch && sendObject(ch, arguments[1]))
+            ? trueobj : falseobj;
+        break;
+
+    case 2:         /* receive an object */
+        ch = channelAt(arguments[0]);
+        if (!ch) { break; }
+
+        // Let other processes run until there is something to read.
+        if (!schedWaitForFd(ch->in)) {
+            returnedObject = arguments[1];      /* try again */
+            break;
+        }
+
+        returnedObject = receiveObject(ch, &eof);
+        if (eof) {
+            // A worker whose parent has gone away has nothing left to
+            // do.
+            if (ch == &channels[0] && isWorker) { exit(0); }
+            closeChannel(ch);
+        }
+        break;
+
+    case 3:         /* stop a worker */
+        ch = channelAt(arguments[0]);
+        if (ch && ch != &channels[0]) {
+            closeChannel(ch);
+        }
+        break;
+
+    case 4:         /* the number of workers worth starting */
+        slot = sysconf(_SC_NPROCESSORS_ONLN);
+        returnedObject = newInteger(slot < 1 ? 1
+                                    : slot > WORKER_MAX ? WORKER_MAX : slot);
+        break;
+
+    case 5:         /* split a collection into chunks */
+        if (!isInteger(arguments[0]) && arguments[0] != nilobj &&
+            isInteger(arguments[1])) {
+            returnedObject = chunksOf(arguments[0], intValue(arguments[1]));
+        }
+        break;
+
+    case 6:         /* concatenate an Array of Arrays */
+        if (!isInteger(arguments[0]) && arguments[0] != nilobj &&
+            sizeField(arguments[0]) >= 0) {
+            returnedObject = join(arguments[0]);
+        }
+        break;
+
+    default:
+        sysError("unknown primitive", "workerPrimitive");
+        break;
+    }
+
+    return returnedObject;
+}// workerPrimitive
@@ -0,0 +1,10 @@
+/*
+    Worker VMs: copies of the VM in child processes.
+*/
+
+#ifndef __WORKER_H
+#define __WORKER_H
+
+extern object workerPrimitive(int number, object *arguments);
+
+#endif